@@ -0,0 +1,98 @@
+#ifndef AABB_H
+#define AABB_H
+
+/*
+    Axis aligned bounding box, stored as one interval per axis. A ray
+    hits the box if the t intervals where it lies inside each of the
+    three slabs overlap.
+*/
+
+#include "rtweekend.h"
+
+class aabb {
+    public:
+        interval x, y, z;
+
+        aabb() {} // the default aabb is empty, since intervals are empty by default.
+
+        aabb(const interval& x_, const interval& y_, const interval& z_) : x(x_), y(y_), z(z_) {
+            pad_to_minimums();
+        }
+
+        aabb(const point3& a, const point3& b) {
+            // treat the two points a and b as extrema for the bounding box.
+            x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
+            y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
+            z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+            pad_to_minimums();
+        }
+
+        aabb(const aabb& box0, const aabb& box1) {
+            // smallest box enclosing both boxes.
+            x = interval(box0.x, box1.x);
+            y = interval(box0.y, box1.y);
+            z = interval(box0.z, box1.z);
+        }
+
+        const interval& axis_interval(int n) const {
+            if (n == 1) return y;
+            if (n == 2) return z;
+            return x;
+        }
+
+        bool hit(const ray& r, interval ray_t) const {
+            const point3& ray_orig = r.origin();
+            const vec3& ray_dir = r.direction();
+
+            for (int axis = 0; axis < 3; axis++) {
+                const interval& ax = axis_interval(axis);
+                const real adinv = real(1) / ray_dir[axis];
+
+                auto t0 = (ax.min - ray_orig[axis]) * adinv;
+                auto t1 = (ax.max - ray_orig[axis]) * adinv;
+
+                if (t0 < t1) {
+                    if (t0 > ray_t.min) ray_t.min = t0;
+                    if (t1 < ray_t.max) ray_t.max = t1;
+                } else {
+                    if (t1 > ray_t.min) ray_t.min = t1;
+                    if (t0 < ray_t.max) ray_t.max = t0;
+                }
+
+                if (ray_t.max <= ray_t.min) return false;
+            }
+            return true;
+        }
+
+        int longest_axis() const {
+            // returns the index of the longest axis of the bounding box.
+            if (x.size() > y.size()) return x.size() > z.size() ? 0 : 2;
+            return y.size() > z.size() ? 1 : 2;
+        }
+
+        double surface_area() const {
+            // used by the SAH cost in the bvh build. empty boxes have no area.
+            if (x.size() < 0 || y.size() < 0 || z.size() < 0) return 0;
+            return 2 * (x.size()*y.size() + y.size()*z.size() + z.size()*x.size());
+        }
+
+        point3 centroid() const {
+            return point3(0.5*(x.min + x.max), 0.5*(y.min + y.max), 0.5*(z.min + z.max));
+        }
+
+        static const aabb empty, universe;
+
+    private:
+        void pad_to_minimums() {
+            // adjust the aabb so that no side is narrower than some delta, padding if necessary.
+            double delta = 0.0001;
+            if (x.size() < delta) x = x.expand(delta);
+            if (y.size() < delta) y = y.expand(delta);
+            if (z.size() < delta) z = z.expand(delta);
+        }
+};
+
+const aabb aabb::empty = aabb(interval::empty, interval::empty, interval::empty);
+const aabb aabb::universe = aabb(interval::universe, interval::universe, interval::universe);
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+/*
+    Running per-pixel sums for progressive rendering.
+
+    Each pixel keeps the sum of its samples (in double, so thousands of
+    passes don't lose precision), the sum of their squared luminance (for
+    the variance the adaptive sampler looks at) and how many samples went
+    into it. With counter based sampling sample n of a pixel is a pure
+    function of (seed, pixel, n) for a given scene and camera, so saving
+    the sums and the counts is enough to stop a render and later carry on
+    with exactly the samples it would have taken next. Only if nothing else
+    changed, though, so the checkpoint also records a checkpoint_key: the
+    seed, the sample pattern (halton and zsobol lay their points out for
+    the sample count rounded up to a power of two), a hash of the scene,
+    the camera's view and the path depth. A render whose key differs in
+    any of them doesn't resume from the file.
+
+    Checkpoint file layout, little endian whatever the machine:
+        "RTACC004"                      8 byte magic and version
+        int32 width, int32 height
+        uint64 sampling seed
+        uint32 sampler                  sampler_type
+        uint32 log2 samples per pixel   the pattern's, see sample_pattern::layout_log2_spp
+        uint64 scene hash               see camera::scene_hash
+        double view[12]                 lookfrom, lookat, vup, vfov, defocus angle, focus distance
+        int32 max_depth, int32 russian_roulette_depth
+        uint32 count[width*height]
+        double sum[width*height*3]      rgb, rows top to bottom
+        double sum_sq[width*height]     squared luminance
+*/
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "sampler.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class checkpoint_status {
+    loaded,
+    missing,      // no file at the path, a new render.
+    incompatible, // a file that isn't a checkpoint of this render, see the error.
+};
+
+struct checkpoint_key {
+    // what a checkpoint has to match, besides the image size, to be resumed.
+    std::uint64_t seed;
+    sampler_type sampler;
+    int log2_spp; // sample_pattern::layout_log2_spp.
+    std::uint64_t scene_hash;
+    std::array<double, 12> view; // lookfrom, lookat, vup, vfov, defocus_angle, focus_dist.
+    std::array<std::int32_t, 2> depth; // max_depth, russian_roulette_depth.
+};
+
+class accumulation_buffer {
+    public:
+        int width = 0;
+        int height = 0;
+        std::vector<double> sum; // 3 per pixel.
+        std::vector<double> sum_sq; // sum of the squared luminance of each sample.
+        std::vector<std::uint32_t> count; // samples taken, per pixel.
+
+        accumulation_buffer() {}
+
+        accumulation_buffer(int width_, int height_)
+            : width(width_), height(height_),
+              sum(size_t(width_) * height_ * 3, 0.0), sum_sq(size_t(width_) * height_, 0.0),
+              count(size_t(width_) * height_, 0) {}
+
+        size_t pixel_index(int i, int j) const { return size_t(j)*width + i; }
+
+        void add(int i, int j, const color& sample_sum, double luminance_sq_sum, int samples) {
+            // adds the sums of another `samples` samples of pixel (i,j).
+            size_t p = pixel_index(i, j);
+            sum[3*p + 0] += sample_sum.x();
+            sum[3*p + 1] += sample_sum.y();
+            sum[3*p + 2] += sample_sum.z();
+            sum_sq[p] += luminance_sq_sum;
+            count[p] += std::uint32_t(samples);
+        }
+
+        double display_error(size_t p) const {
+            /*
+                estimated noise of pixel p as it will be displayed: half the width, after the
+                gamma 2 of the output, of the one standard error band around its mean luminance.
+                measuring after gamma spends the samples where noise is visible, and unlike
+                relative error it stays finite for black pixels.
+            */
+            double n = count[p];
+            if (n < 2) return infinity;
+            double mean = luminance(color(sum[3*p + 0], sum[3*p + 1], sum[3*p + 2])) / n;
+            double variance = std::max(0.0, (sum_sq[p] - n*mean*mean) / (n - 1));
+            double std_error = std::sqrt(variance / n);
+            return 0.5 * (std::sqrt(std::max(0.0, mean + std_error)) - std::sqrt(std::max(0.0, mean - std_error)));
+        }
+
+        std::uint32_t min_count() const {
+            return count.empty() ? 0 : *std::min_element(count.begin(), count.end());
+        }
+
+        void resolve(framebuffer& image) const {
+            // the average of every pixel, pixels without samples are black.
+            image.resize(width, height);
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    size_t p = pixel_index(i, j);
+                    if (count[p] == 0) continue;
+                    color total(sum[3*p + 0], sum[3*p + 1], sum[3*p + 2]);
+                    image.set(i, j, total * real(1.0 / count[p]));
+                }
+            }
+        }
+
+        bool save(const std::string& path, const checkpoint_key& key) const {
+            // writes to a temporary file and renames it over path, so a render killed in the
+            // middle of a save still leaves the previous checkpoint intact.
+            std::string temp_path = path + ".tmp";
+            {
+                std::ofstream out(temp_path, std::ios::binary);
+                if (!out) return false;
+                std::int32_t size[2] = {width, height};
+                out.write(magic, 8);
+                std::uint32_t pattern[2] = {std::uint32_t(key.sampler), std::uint32_t(key.log2_spp)};
+                write_little_endian(out, size, 2);
+                write_little_endian(out, &key.seed, 1);
+                write_little_endian(out, pattern, 2);
+                write_little_endian(out, &key.scene_hash, 1);
+                write_little_endian(out, key.view.data(), key.view.size());
+                write_little_endian(out, key.depth.data(), key.depth.size());
+                write_little_endian(out, count.data(), count.size());
+                write_little_endian(out, sum.data(), sum.size());
+                write_little_endian(out, sum_sq.data(), sum_sq.size());
+                if (!out.flush()) return false;
+            }
+            std::error_code error;
+            std::filesystem::rename(temp_path, path, error);
+            return !error;
+        }
+
+        checkpoint_status load(const std::string& path, const checkpoint_key& key, std::string& error) {
+            // reads a checkpoint saved by save(). anything but loaded leaves the buffer alone;
+            // a file that is unreadable, truncated, or from a render with another size or key
+            // is incompatible, and error says why.
+            std::error_code exists_error;
+            if (!std::filesystem::exists(path, exists_error) && !exists_error) return checkpoint_status::missing;
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                error = "can't be read";
+                return checkpoint_status::incompatible;
+            }
+
+            char file_magic[8];
+            std::int32_t size[2];
+            std::uint64_t file_seed;
+            std::uint32_t pattern[2];
+            checkpoint_key file_key;
+            in.read(file_magic, 8);
+            read_little_endian(in, size, 2);
+            read_little_endian(in, &file_seed, 1);
+            read_little_endian(in, pattern, 2);
+            read_little_endian(in, &file_key.scene_hash, 1);
+            read_little_endian(in, file_key.view.data(), file_key.view.size());
+            read_little_endian(in, file_key.depth.data(), file_key.depth.size());
+            if (!in || std::memcmp(file_magic, magic, 8) != 0) {
+                error = "not a checkpoint file, or from another version";
+                return checkpoint_status::incompatible;
+            }
+            if (size[0] != width || size[1] != height) {
+                error = "the image is " + std::to_string(size[0]) + "x" + std::to_string(size[1]) + ", not "
+                      + std::to_string(width) + "x" + std::to_string(height);
+                return checkpoint_status::incompatible;
+            }
+            if (file_seed != key.seed) {
+                error = "another sampling seed";
+                return checkpoint_status::incompatible;
+            }
+            if (pattern[0] != std::uint32_t(key.sampler)) {
+                error = std::string("sampled with ") + sampler_name(sampler_type(pattern[0])) + ", not "
+                      + sampler_name(key.sampler);
+                return checkpoint_status::incompatible;
+            }
+            if (pattern[1] != std::uint32_t(key.log2_spp)) {
+                error = "the sample pattern is laid out for " + std::to_string(1ull << std::min(pattern[1], 63u))
+                      + " samples per pixel, not " + std::to_string(1ull << key.log2_spp);
+                return checkpoint_status::incompatible;
+            }
+            if (file_key.scene_hash != key.scene_hash) {
+                error = "another scene";
+                return checkpoint_status::incompatible;
+            }
+            if (file_key.view != key.view) {
+                error = "another camera view or focus";
+                return checkpoint_status::incompatible;
+            }
+            if (file_key.depth != key.depth) {
+                error = "a max depth of " + std::to_string(file_key.depth[0]) + " and russian roulette depth of "
+                      + std::to_string(file_key.depth[1]) + ", not " + std::to_string(key.depth[0]) + " and "
+                      + std::to_string(key.depth[1]);
+                return checkpoint_status::incompatible;
+            }
+
+            std::vector<std::uint32_t> file_count(count.size());
+            std::vector<double> file_sum(sum.size());
+            std::vector<double> file_sum_sq(sum_sq.size());
+            read_little_endian(in, file_count.data(), file_count.size());
+            read_little_endian(in, file_sum.data(), file_sum.size());
+            read_little_endian(in, file_sum_sq.data(), file_sum_sq.size());
+            if (!in) {
+                error = "truncated";
+                return checkpoint_status::incompatible;
+            }
+
+            count.swap(file_count);
+            sum.swap(file_sum);
+            sum_sq.swap(file_sum_sq);
+            return checkpoint_status::loaded;
+        }
+
+    private:
+        static constexpr const char* magic = "RTACC004";
+
+        template <typename T>
+        static void write_little_endian(std::ostream& out, const T* values, size_t n) {
+            if constexpr (std::endian::native == std::endian::little) {
+                out.write(reinterpret_cast<const char*>(values), std::streamsize(n * sizeof(T)));
+            } else {
+                for (size_t k = 0; k < n; k++) {
+                    char bytes[sizeof(T)];
+                    std::memcpy(bytes, &values[k], sizeof(T));
+                    std::reverse(bytes, bytes + sizeof(T));
+                    out.write(bytes, sizeof(T));
+                }
+            }
+        }
+
+        template <typename T>
+        static void read_little_endian(std::istream& in, T* values, size_t n) {
+            in.read(reinterpret_cast<char*>(values), std::streamsize(n * sizeof(T)));
+            if constexpr (std::endian::native != std::endian::little) {
+                for (size_t k = 0; k < n; k++) {
+                    char bytes[sizeof(T)];
+                    std::memcpy(bytes, &values[k], sizeof(T));
+                    std::reverse(bytes, bytes + sizeof(T));
+                    std::memcpy(&values[k], bytes, sizeof(T));
+                }
+            }
+        }
+};
+
+#endif
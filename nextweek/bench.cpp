@@ -0,0 +1,301 @@
+/*
+    Microbenchmarks for the hot kernels of the renderer: ray/sphere and
+    ray/list intersection (one at a time and as a SIMD sphere_batch), the
+    random direction samplers and the three material scatter functions.
+
+    Every benchmark runs its kernel over a fixed set of inputs generated
+    from a fixed seed, so two builds time exactly the same work. After a
+    warmup, the number of passes over the inputs per repetition is picked
+    so one repetition takes about --min-time milliseconds; the reported
+    time per op is the median over --reps repetitions, with the minimum and
+    the median absolute deviation alongside to show how stable it was.
+
+    usage: bench [--filter TEXT] [--reps N] [--min-time MS] [--json FILE]
+
+    A table goes to stderr and the results as JSON to stdout (or FILE), so
+    runs of two commits can be diffed or compared with a script.
+*/
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "simd.h"
+#include "sphere.h"
+#include "sphere_batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    constexpr std::uint64_t input_seed = 0x5eed5eed12345678ull;
+    constexpr int input_count = 4096; // rays (or records) each kernel cycles through.
+
+    volatile double sink; // results go here, so the kernels can't be optimized away.
+
+    struct bench_result {
+        std::string name;
+        std::string unit; // what one op is: a ray, a sample, a scatter.
+        double ns_per_op; // median over the repetitions.
+        double ns_min;
+        double ns_mad; // median absolute deviation.
+        long long ops; // per repetition.
+    };
+
+    struct bench_options {
+        std::string filter;
+        int reps = 15;
+        double min_time_ms = 20;
+    };
+
+    double median(std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        size_t n = v.size();
+        return n % 2 ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+    }
+
+    /*
+        times pass(), which runs the kernel once over all inputs (ops_per_pass ops) and
+        returns a checksum. returns false if the filter skips the benchmark.
+    */
+    bool run_benchmark(const bench_options& options, const std::string& name, const std::string& unit,
+            int ops_per_pass, const std::function<double()>& pass, std::vector<bench_result>& results) {
+        if (name.find(options.filter) == std::string::npos) return false;
+
+        using clock = std::chrono::steady_clock;
+        auto time_passes = [&](long long passes) {
+            double checksum = 0;
+            auto start = clock::now();
+            for (long long k = 0; k < passes; k++) checksum += pass();
+            std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+            sink = checksum;
+            return elapsed.count();
+        };
+
+        // warm up caches, branch predictors and the clock, and find out how many passes
+        // fill min_time.
+        seed_thread_rng(input_seed);
+        long long passes = 1;
+        double ms = time_passes(passes);
+        while (ms < options.min_time_ms / 4) {
+            passes *= 2;
+            ms = time_passes(passes);
+        }
+        passes = std::max(1LL, (long long)(passes * options.min_time_ms / std::max(ms, 1e-3)));
+
+        std::vector<double> ns_per_op;
+        for (int rep = 0; rep < options.reps; rep++) {
+            // the same random numbers every repetition (for the kernels that draw them).
+            seed_thread_rng(input_seed);
+            double elapsed = time_passes(passes);
+            ns_per_op.push_back(elapsed * 1e6 / (double(passes) * ops_per_pass));
+        }
+
+        bench_result result;
+        result.name = name;
+        result.unit = unit;
+        result.ns_per_op = median(ns_per_op);
+        result.ns_min = *std::min_element(ns_per_op.begin(), ns_per_op.end());
+        std::vector<double> deviations;
+        for (auto t : ns_per_op) deviations.push_back(std::fabs(t - result.ns_per_op));
+        result.ns_mad = median(deviations);
+        result.ops = passes * ops_per_pass;
+        results.push_back(result);
+
+        std::fprintf(stderr, "%-28s %10.2f ns/%-8s %8.2f M%s/s   (min %.2f, mad %.1f%%)\n",
+            name.c_str(), result.ns_per_op, unit.c_str(), 1e3 / result.ns_per_op, unit.c_str(),
+            result.ns_min, 100 * result.ns_mad / result.ns_per_op);
+        return true;
+    }
+
+    void write_json(std::ostream& out, const std::vector<bench_result>& results, const bench_options& options) {
+        out << "{\n";
+        out << "  \"real\": \"" << (std::is_same_v<real, float> ? "float" : "double") << "\",\n";
+        out << "  \"simd\": \"" << simd_double::isa << "\",\n";
+        out << "  \"reps\": " << options.reps << ",\n";
+        out << "  \"benchmarks\": [\n";
+        for (size_t k = 0; k < results.size(); k++) {
+            const auto& r = results[k];
+            char line[512];
+            std::snprintf(line, sizeof(line),
+                "    {\"name\": \"%s\", \"unit\": \"%s\", \"ns_per_op\": %.4f, \"ns_min\": %.4f, "
+                "\"ns_mad\": %.4f, \"ops_per_second\": %.6g, \"ops\": %lld}%s\n",
+                r.name.c_str(), r.unit.c_str(), r.ns_per_op, r.ns_min, r.ns_mad, 1e9 / r.ns_per_op,
+                r.ops, k + 1 < results.size() ? "," : "");
+            out << line;
+        }
+        out << "  ]\n}\n";
+    }
+
+    std::vector<ray> rays_towards(const point3& target, double spread, xoshiro256pp& rng) {
+        // rays from around the origin aimed at target, scattered over a disk of radius spread.
+        std::vector<ray> rays;
+        for (int k = 0; k < input_count; k++) {
+            point3 origin(0.1 * rng.next_double(), 0.1 * rng.next_double(), 0);
+            vec3 offset(spread * (2*rng.next_double() - 1), spread * (2*rng.next_double() - 1), 0);
+            rays.push_back(ray(origin, target + offset - origin));
+        }
+        return rays;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    bench_options options;
+    std::string json_path;
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--filter" && k + 1 < argc) options.filter = argv[++k];
+        else if (arg == "--reps" && k + 1 < argc) options.reps = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--min-time" && k + 1 < argc) options.min_time_ms = std::atof(argv[++k]);
+        else if (arg == "--json" && k + 1 < argc) json_path = argv[++k];
+        else {
+            std::cerr << "usage: bench [--filter TEXT] [--reps N] [--min-time MS] [--json FILE]\n";
+            return 1;
+        }
+    }
+
+    xoshiro256pp rng(input_seed);
+    std::vector<bench_result> results;
+
+    // intersection.
+
+    material_table materials;
+    auto gray = materials.add(make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+    sphere_shape target(point3(0, 0, -3), 1.0, gray);
+
+    auto hit_rays = rays_towards(target.center, 0.7, rng);
+    auto miss_rays = rays_towards(target.center + vec3(3, 0, 0), 0.7, rng);
+    auto mixed_rays = rays_towards(target.center, 1.4, rng); // about 40% hit.
+
+    auto intersect = [&](const std::vector<ray>& rays) {
+        return [&target, &rays] {
+            double checksum = 0;
+            hit_record rec;
+            for (const auto& r : rays)
+                if (target.hit(r, interval(0.001, infinity), rec)) checksum += rec.t;
+            return checksum;
+        };
+    };
+    run_benchmark(options, "sphere_hit/hit", "ray", input_count, intersect(hit_rays), results);
+    run_benchmark(options, "sphere_hit/miss", "ray", input_count, intersect(miss_rays), results);
+    run_benchmark(options, "sphere_hit/mixed", "ray", input_count, intersect(mixed_rays), results);
+
+    // a small list of virtual spheres in front of the camera, the way hittable_list
+    // is used under the bvh leaves and in the weekend scenes, and the same spheres in a
+    // sphere_batch. 512 is about the size of the random scene.
+    for (int count : {4, 32, 512}) {
+        hittable_list list;
+        sphere_batch batch;
+        for (int k = 0; k < count; k++) {
+            point3 center(4*rng.next_double() - 2, 4*rng.next_double() - 2, -3 - 4*rng.next_double());
+            auto radius = 0.2 + 0.3*rng.next_double();
+            list.add(make_shared<sphere>(center, radius, gray));
+            batch.add(center, radius, gray);
+        }
+        auto rays = rays_towards(point3(0, 0, -5), 2.0, rng);
+        run_benchmark(options, "hittable_list_hit/" + std::to_string(count), "ray", input_count, [&] {
+            double checksum = 0;
+            hit_record rec;
+            for (const auto& r : rays)
+                if (list.hit(r, interval(0.001, infinity), rec)) checksum += rec.t;
+            return checksum;
+        }, results);
+        run_benchmark(options, "sphere_batch_hit/" + std::to_string(count), "ray", input_count, [&] {
+            double checksum = 0;
+            hit_record rec;
+            for (const auto& r : rays)
+                if (batch.hit(r, interval(0.001, infinity), rec)) checksum += rec.t;
+            return checksum;
+        }, results);
+    }
+
+    // sampling. these draw from the calling thread's generator, reseeded before every repetition.
+
+    run_benchmark(options, "random_double", "sample", input_count, [] {
+        double checksum = 0;
+        for (int k = 0; k < input_count; k++) checksum += random_double();
+        return checksum;
+    }, results);
+
+    run_benchmark(options, "random_unit_vector", "sample", input_count, [] {
+        vec3 sum(0, 0, 0);
+        for (int k = 0; k < input_count; k++) sum += random_unit_vector();
+        return double(sum.x() + sum.y() + sum.z());
+    }, results);
+
+    run_benchmark(options, "random_in_unit_disk", "sample", input_count, [] {
+        vec3 sum(0, 0, 0);
+        for (int k = 0; k < input_count; k++) sum += random_in_unit_disk();
+        return double(sum.x() + sum.y());
+    }, results);
+
+    for (auto type : {sampler_type::independent, sampler_type::sobol, sampler_type::halton, sampler_type::zsobol}) {
+        // the per-sample streams, as the deterministic renders draw them: two dimensions per
+        // bounce for eight bounces.
+        sample_stream stream;
+        stream.pattern = sample_pattern(type, 1200, 675, 64);
+        run_benchmark(options, std::string("sample_stream/") + sampler_name(type), "sample", input_count, [&] {
+            double checksum = 0;
+            for (int k = 0; k < input_count / 16; k++) {
+                stream.start(input_seed, std::uint32_t(k * 7919), std::uint32_t(k & 63));
+                for (std::uint32_t bounce = 0; bounce < 8; bounce++) {
+                    stream.set_bounce(bounce);
+                    checksum += stream.next_double();
+                    checksum += stream.next_double();
+                }
+            }
+            return checksum;
+        }, results);
+    }
+
+    // scattering, through the material vtable like the hittable render path. the hit
+    // records are real hits on the target sphere.
+
+    std::vector<ray> scatter_rays;
+    std::vector<hit_record> records;
+    for (const auto& r : hit_rays) {
+        hit_record rec;
+        if (!target.hit(r, interval(0.001, infinity), rec)) continue;
+        scatter_rays.push_back(r);
+        records.push_back(rec);
+    }
+
+    struct { const char* name; shared_ptr<material> mat; } scatterers[] = {
+        {"scatter/lambertian", make_shared<lambertian>(color(0.7, 0.3, 0.3))},
+        {"scatter/metal", make_shared<metal>(color(0.8, 0.6, 0.2), 0.3)},
+        {"scatter/dielectric", make_shared<dielectric>(1.5)},
+    };
+    for (auto& s : scatterers) {
+        const material* mat = materials.add(s.mat);
+        for (auto& rec : records) rec.mat = mat;
+        run_benchmark(options, s.name, "scatter", int(records.size()), [&] {
+            double checksum = 0;
+            color attenuation;
+            ray scattered;
+            for (size_t k = 0; k < records.size(); k++)
+                if (records[k].mat->scatter(scatter_rays[k], records[k], attenuation, scattered))
+                    checksum += scattered.direction().x();
+            return checksum;
+        }, results);
+    }
+
+    if (json_path.empty()) {
+        write_json(std::cout, results, options);
+    } else {
+        std::ofstream file(json_path);
+        if (!file) {
+            std::cerr << "Can't open " << json_path << " for writing.\n";
+            return 1;
+        }
+        write_json(file, results, options);
+    }
+}
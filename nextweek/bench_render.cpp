@@ -0,0 +1,254 @@
+/*
+    End to end render throughput of the scene presets in scenes.h.
+
+    Every preset is built once, then rendered --reps times into a
+    framebuffer (nothing is written to disk). Reported per scene: the
+    median and minimum wall time of the renders, rays traced per second
+    (every world.hit call, camera rays and bounces alike), samples per
+    second, the time to build the scene, its primitive count (spheres,
+    triangles and instances) and the peak resident memory of the process so
+    far. Results go to stdout (or --json FILE) as JSON; a one
+    line summary per scene goes to stderr.
+
+    usage: bench_render [--scene NAME]... [--width W] [--spp N] [--depth D]
+                        [--threads T] [--reps R] [--closed] [--batch]
+                        [--deterministic] [--huge-pages] [--json FILE]
+
+    Without --scene every preset is rendered. Defaults are 400 pixels wide,
+    16 samples per pixel and depth 50, which takes a few seconds per scene.
+    --huge-pages backs the scene arena with huge pages, so it can't go with
+    --closed, whose world doesn't live in an arena.
+*/
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "closed_scene.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "scenes.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+    // rays are counted per thread, and a render thread adds its count to the total as it exits.
+    std::atomic<std::uint64_t> exited_thread_rays{0};
+
+    struct thread_ray_count {
+        std::uint64_t rays = 0;
+        ~thread_ray_count() { exited_thread_rays += rays; }
+    };
+
+    thread_ray_count& thread_rays() {
+        thread_local thread_ray_count count;
+        return count;
+    }
+
+    std::uint64_t rays_traced() {
+        // the render threads are joined by now, the calling thread rendered as thread 0.
+        return exited_thread_rays.load() + thread_rays().rays;
+    }
+
+    void reset_rays() {
+        exited_thread_rays = 0;
+        thread_rays().rays = 0;
+    }
+
+    template <typename World>
+    class counted_world {
+        // passes everything through to world, counting the rays on the way.
+        public:
+            explicit counted_world(const World& world_) : world(world_) {}
+
+            bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+                thread_rays().rays++;
+                return world.hit(r, ray_t, rec);
+            }
+
+            bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const {
+                if constexpr (std::is_base_of_v<hittable, World>)
+                    return rec.mat->scatter(r_in, rec, attenuation, scattered);
+                else
+                    return world.scatter(r_in, rec, attenuation, scattered);
+            }
+
+        private:
+            const World& world;
+    };
+
+    double peak_rss_mb() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return double(usage.ru_maxrss) / (1024.0 * 1024.0); // bytes.
+#else
+        return double(usage.ru_maxrss) / 1024.0; // kilobytes.
+#endif
+    }
+
+    struct run_result {
+        std::string scene;
+        size_t primitives;
+        double build_seconds;
+        double wall_seconds; // median over the repetitions.
+        double wall_min;
+        std::uint64_t rays; // per render.
+        double samples; // per render.
+        double peak_rss_mb;
+    };
+
+    double median(std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        size_t n = v.size();
+        return n % 2 ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+    }
+
+    template <typename World>
+    run_result time_renders(camera& cam, const World& world, int reps) {
+        counted_world<World> counted(world);
+        framebuffer image;
+        std::vector<double> seconds;
+        run_result result{};
+        for (int rep = 0; rep < reps; rep++) {
+            reset_rays();
+            auto start = std::chrono::steady_clock::now();
+            cam.render(counted, image);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds.push_back(elapsed.count());
+            result.rays = rays_traced();
+        }
+        result.wall_seconds = median(seconds);
+        result.wall_min = *std::min_element(seconds.begin(), seconds.end());
+        result.samples = double(image.width) * image.height * cam.samples_per_pixel;
+        return result;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<scene_id> scenes;
+    int width = 400;
+    int samples_per_pixel = 16;
+    int max_depth = 50;
+    int threads = 0;
+    int reps = 3;
+    bool closed = false;
+    bool batch = false;
+    bool deterministic = false;
+    bool huge_pages = false;
+    std::string json_path;
+
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        scene_id id;
+        if (arg == "--scene" && k + 1 < argc && scene_id_for(argv[k + 1], id)) {
+            scenes.push_back(id);
+            k++;
+        }
+        else if (arg == "--width" && k + 1 < argc) width = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--spp" && k + 1 < argc) samples_per_pixel = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--depth" && k + 1 < argc) max_depth = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--threads" && k + 1 < argc) threads = std::atoi(argv[++k]);
+        else if (arg == "--reps" && k + 1 < argc) reps = std::max(1, std::atoi(argv[++k]));
+        else if (arg == "--closed") closed = true;
+        else if (arg == "--batch") batch = true;
+        else if (arg == "--deterministic") deterministic = true;
+        else if (arg == "--huge-pages") huge_pages = true;
+        else if (arg == "--json" && k + 1 < argc) json_path = argv[++k];
+        else {
+            std::cerr << "usage: bench_render [--scene random|material_test|dense|instanced]... [--width W] [--spp N]\n"
+                         "                    [--depth D] [--threads T] [--reps R] [--closed] [--batch]\n"
+                         "                    [--deterministic] [--huge-pages] [--json FILE]\n";
+            return 1;
+        }
+    }
+    if (huge_pages && closed) {
+        std::cerr << "--huge-pages is for the arena of the hittable world, --closed doesn't use one.\n";
+        return 1;
+    }
+    if (scenes.empty()) scenes = {scene_id::random, scene_id::material_test, scene_id::dense, scene_id::instanced};
+
+    std::vector<run_result> results;
+    int height = 0;
+    for (auto id : scenes) {
+        camera cam;
+        set_scene_view(id, cam);
+        cam.image_width = width;
+        cam.samples_per_pixel = samples_per_pixel;
+        cam.max_depth = max_depth;
+        cam.num_threads = threads;
+        cam.deterministic_sampling = deterministic;
+        cam.show_progress = false;
+        height = std::max(int(width / cam.aspect_ratio), 1);
+
+        run_result result;
+        auto build_start = std::chrono::steady_clock::now();
+        scene_description description = preset_scene(id);
+        if (closed) {
+            closed_scene world;
+            build_world(description, world);
+            std::chrono::duration<double> build = std::chrono::steady_clock::now() - build_start;
+            result = time_renders(cam, world, reps);
+            result.build_seconds = build.count();
+        } else {
+            hittable_list world;
+            material_table materials;
+            if (batch) build_batch_world(description, world, materials, scene_arena(huge_pages));
+            else build_world(description, world, materials, scene_arena(huge_pages));
+            std::chrono::duration<double> build = std::chrono::steady_clock::now() - build_start;
+            result = time_renders(cam, world, reps);
+            result.build_seconds = build.count();
+        }
+        result.primitives = description.primitive_count();
+        result.scene = scene_name(id);
+        result.peak_rss_mb = peak_rss_mb();
+        results.push_back(result);
+
+        std::fprintf(stderr, "%-14s %8.3f s  %8.2f Mrays/s  %8.3f Msamples/s  %7.1f MB\n",
+            result.scene.c_str(), result.wall_seconds, result.rays / result.wall_seconds * 1e-6,
+            result.samples / result.wall_seconds * 1e-6, result.peak_rss_mb);
+    }
+
+    std::ofstream file;
+    if (!json_path.empty()) {
+        file.open(json_path);
+        if (!file) {
+            std::cerr << "Can't open " << json_path << " for writing.\n";
+            return 1;
+        }
+    }
+    std::ostream& out = json_path.empty() ? std::cout : file;
+
+    char line[512];
+    out << "{\n";
+    std::snprintf(line, sizeof(line),
+        "  \"width\": %d, \"height\": %d, \"spp\": %d, \"max_depth\": %d, \"threads\": %d, \"reps\": %d,\n"
+        "  \"world\": \"%s\", \"sampling\": \"%s\", \"real\": \"%s\",\n",
+        width, height, samples_per_pixel, max_depth, tile_scheduler(threads).thread_count(), reps,
+        closed ? "closed" : batch ? "batch" : "hittable", deterministic ? "deterministic" : "independent",
+        std::is_same_v<real, float> ? "float" : "double");
+    out << line;
+    out << "  \"scenes\": [\n";
+    for (size_t k = 0; k < results.size(); k++) {
+        const auto& r = results[k];
+        std::snprintf(line, sizeof(line),
+            "    {\"scene\": \"%s\", \"primitives\": %zu, \"build_seconds\": %.4f, \"wall_seconds\": %.4f, "
+            "\"wall_min\": %.4f, \"rays\": %llu, \"mrays_per_second\": %.3f, \"samples_per_second\": %.6g, "
+            "\"peak_rss_mb\": %.1f}%s\n",
+            r.scene.c_str(), r.primitives, r.build_seconds, r.wall_seconds, r.wall_min,
+            (unsigned long long)r.rays, r.rays / r.wall_seconds * 1e-6, r.samples / r.wall_seconds,
+            r.peak_rss_mb, k + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
@@ -0,0 +1,318 @@
+#ifndef BVH_H
+#define BVH_H
+
+/*
+    Bounding volume hierarchy.
+
+    The tree is built top-down with the surface area heuristic (SAH): at each
+    node the primitive centroids are dropped into a handful of bins along every
+    axis and the split with the lowest expected intersection cost
+        C = C_trav + (A_left*N_left + A_right*N_right) / A_node
+    is taken. The finished tree is flattened depth first into one contiguous
+    array, so the left child of a node is always the next node and only the
+    right child needs an offset. Traversal walks that array with a small
+    explicit stack, visiting the near child first.
+
+    bvh_tree only knows about boxes and primitive indices, bvh_node is the
+    hittable built on top of it for a list of hittables. The traversal
+    itself is in bvh_view, which only needs the two arrays, wherever they
+    live.
+*/
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "hittable.h"
+#include "hittable_list.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+struct alignas(8*sizeof(real)) bvh_flat_node { // one cache line in double, half of one in float.
+    real bmin[3]; // box of the node, stored flat for the traversal loop.
+    real bmax[3];
+    std::uint32_t offset; // interior node: index of the right child. leaf: first slot in the index array.
+    std::uint16_t count; // primitives in a leaf, 0 for interior nodes.
+    std::uint16_t axis; // split axis of an interior node.
+};
+
+struct bvh_view {
+    // a flattened tree wherever its arrays are: in a bvh_tree, or mapped from a scene file.
+    const bvh_flat_node* nodes = nullptr;
+    std::size_t node_count = 0;
+    const std::uint32_t* indices = nullptr;
+
+    static constexpr int max_depth = 128; // deepest tree the traversal stack holds.
+
+    /*
+        walk the tree and call hit_primitive(index, ray_t) for every primitive in a leaf the
+        ray reaches. hit_primitive returns true on a hit, and must then shrink ray_t.max to
+        the hit distance so the rest of the tree is culled against the closest hit so far.
+    */
+    template <typename F>
+    bool hit(const ray& r, interval& ray_t, F&& hit_primitive) const {
+        if (node_count == 0) return false;
+
+        real orig[3], inv_dir[3];
+        bool dir_neg[3];
+        for (int a = 0; a < 3; a++) {
+            orig[a] = r.origin()[a];
+            inv_dir[a] = real(1) / r.direction()[a];
+            dir_neg[a] = inv_dir[a] < 0;
+        }
+
+        std::uint32_t stack[max_depth];
+        int stack_size = 0;
+        std::uint32_t current = 0;
+        bool hit_anything = false;
+
+        while (true) {
+            const bvh_flat_node& node = nodes[current];
+            RT_STAT_COUNT(bvh_nodes);
+            if (hit_box(node, orig, inv_dir, ray_t)) {
+                if (node.count > 0) {
+                    for (std::uint32_t k = node.offset; k < node.offset + node.count; k++)
+                        if (hit_primitive(indices[k], ray_t)) hit_anything = true;
+                    if (stack_size == 0) break;
+                    current = stack[--stack_size];
+                } else if (dir_neg[node.axis]) {
+                    // ray runs towards -axis, the right child is nearer.
+                    stack[stack_size++] = current + 1;
+                    current = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    current = current + 1;
+                }
+            } else {
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            }
+        }
+        return hit_anything;
+    }
+
+    static bool hit_box(const bvh_flat_node& node, const real* orig, const real* inv_dir,
+                        const interval& ray_t) {
+        real tmin = ray_t.min, tmax = ray_t.max;
+        for (int a = 0; a < 3; a++) {
+            real t0 = (node.bmin[a] - orig[a]) * inv_dir[a];
+            real t1 = (node.bmax[a] - orig[a]) * inv_dir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+        }
+        return tmin <= tmax;
+    }
+};
+
+class bvh_tree {
+    public:
+        std::vector<bvh_flat_node> nodes; // node 0 is the root.
+        std::vector<std::uint32_t> indices; // primitive indices, each leaf owns a contiguous run.
+
+        bvh_tree() {}
+        explicit bvh_tree(const std::vector<aabb>& boxes) { build(boxes); }
+
+        void build(const std::vector<aabb>& boxes) {
+            nodes.clear();
+            indices.clear();
+            if (boxes.empty()) return;
+
+            std::vector<build_prim> prims(boxes.size());
+            for (size_t i = 0; i < boxes.size(); i++)
+                prims[i] = {boxes[i], boxes[i].centroid(), std::uint32_t(i)};
+
+            nodes.reserve(2*boxes.size());
+            build_node(prims, 0, std::uint32_t(prims.size()), 0);
+
+            indices.resize(prims.size());
+            for (size_t i = 0; i < prims.size(); i++) indices[i] = prims[i].index;
+        }
+
+        aabb bounds() const {
+            if (nodes.empty()) return aabb();
+            const auto& root = nodes[0];
+            return aabb(interval(root.bmin[0], root.bmax[0]),
+                        interval(root.bmin[1], root.bmax[1]),
+                        interval(root.bmin[2], root.bmax[2]));
+        }
+
+        bvh_view view() const { return {nodes.data(), nodes.size(), indices.data()}; }
+
+        template <typename F>
+        bool hit(const ray& r, interval& ray_t, F&& hit_primitive) const {
+            // see bvh_view::hit.
+            return view().hit(r, ray_t, hit_primitive);
+        }
+
+    private:
+        static constexpr int bin_count = 16; // SAH buckets per axis.
+        static constexpr int max_leaf_size = 4; // leaves are never bigger than this.
+        static constexpr int max_depth = bvh_view::max_depth;
+        static constexpr double traversal_cost = 0.125; // cost of visiting a node relative to one primitive test.
+
+        struct build_prim {
+            aabb box;
+            point3 centroid;
+            std::uint32_t index;
+        };
+
+        std::uint32_t make_leaf(std::uint32_t node_index, std::uint32_t begin, std::uint32_t end) {
+            nodes[node_index].offset = begin;
+            nodes[node_index].count = std::uint16_t(end - begin);
+            nodes[node_index].axis = 0;
+            return node_index;
+        }
+
+        std::uint32_t build_node(std::vector<build_prim>& prims, std::uint32_t begin, std::uint32_t end, int depth) {
+            auto node_index = std::uint32_t(nodes.size());
+            nodes.emplace_back();
+
+            // bounds of the node, and the (unpadded) bounds of the primitive centroids.
+            aabb box;
+            interval centroid_bounds[3];
+            for (auto i = begin; i < end; i++) {
+                box = aabb(box, prims[i].box);
+                for (int a = 0; a < 3; a++) {
+                    real c = prims[i].centroid[a];
+                    centroid_bounds[a] = interval(std::fmin(centroid_bounds[a].min, c), std::fmax(centroid_bounds[a].max, c));
+                }
+            }
+            for (int a = 0; a < 3; a++) {
+                nodes[node_index].bmin[a] = box.axis_interval(a).min;
+                nodes[node_index].bmax[a] = box.axis_interval(a).max;
+            }
+
+            auto count = end - begin;
+            if (count == 1) return make_leaf(node_index, begin, end);
+
+            // find the cheapest binned SAH split over all three axes.
+            int best_axis = -1, best_bin = 0;
+            double best_cost = infinity;
+            double parent_area = box.surface_area();
+
+            for (int axis = 0; axis < 3 && parent_area > 0; axis++) {
+                const interval& extent = centroid_bounds[axis];
+                if (extent.size() <= 0) continue; // every centroid on one plane, nothing to bin.
+
+                aabb bin_box[bin_count];
+                int bin_prims[bin_count] = {};
+                for (auto i = begin; i < end; i++) {
+                    int b = bin_of(prims[i].centroid[axis], extent);
+                    bin_prims[b]++;
+                    bin_box[b] = aabb(bin_box[b], prims[i].box);
+                }
+
+                // sweep from the right to get the area and count right of every split plane.
+                double right_area[bin_count];
+                int right_prims[bin_count];
+                aabb acc;
+                int acc_count = 0;
+                for (int b = bin_count - 1; b > 0; b--) {
+                    acc = aabb(acc, bin_box[b]);
+                    acc_count += bin_prims[b];
+                    right_area[b] = acc.surface_area();
+                    right_prims[b] = acc_count;
+                }
+
+                acc = aabb();
+                acc_count = 0;
+                for (int b = 1; b < bin_count; b++) {
+                    // split plane between bin b-1 and bin b.
+                    acc = aabb(acc, bin_box[b-1]);
+                    acc_count += bin_prims[b-1];
+                    if (acc_count == 0 || right_prims[b] == 0) continue;
+
+                    double cost = traversal_cost
+                        + (acc.surface_area()*acc_count + right_area[b]*right_prims[b]) / parent_area;
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin = b;
+                    }
+                }
+            }
+
+            if (count <= std::uint32_t(max_leaf_size) && best_cost >= double(count))
+                return make_leaf(node_index, begin, end); // splitting isn't worth it.
+
+            std::uint32_t mid;
+            if (best_axis >= 0 && depth < max_depth/2) {
+                const interval& extent = centroid_bounds[best_axis];
+                auto it = std::partition(prims.begin() + begin, prims.begin() + end, [&](const build_prim& p) {
+                    return bin_of(p.centroid[best_axis], extent) < best_bin;
+                });
+                mid = std::uint32_t(it - prims.begin());
+            } else {
+                // no usable split plane (all centroids coincide) or the tree got too deep:
+                // halve the range so depth stays logarithmic from here on.
+                int axis = aabb(centroid_bounds[0], centroid_bounds[1], centroid_bounds[2]).longest_axis();
+                mid = begin + count/2;
+                std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end,
+                    [axis](const build_prim& a, const build_prim& b) { return a.centroid[axis] < b.centroid[axis]; });
+                best_axis = axis;
+            }
+
+            build_node(prims, begin, mid, depth + 1);
+            auto right = build_node(prims, mid, end, depth + 1);
+            nodes[node_index].offset = right;
+            nodes[node_index].count = 0;
+            nodes[node_index].axis = std::uint16_t(best_axis);
+            return node_index;
+        }
+
+        static int bin_of(real c, const interval& extent) {
+            int b = int(bin_count * (c - extent.min) / extent.size());
+            return std::clamp(b, 0, bin_count - 1);
+        }
+};
+
+
+class bvh_node : public hittable {
+    public:
+        bvh_node(const hittable_list& list) : bvh_node(list.objects) {}
+
+        bvh_node(const std::vector<shared_ptr<hittable>>& objects_) : owned(objects_) {
+            std::vector<const hittable*> pointers;
+            pointers.reserve(objects_.size());
+            for (const auto& object : objects_) pointers.push_back(object.get());
+            build(pointers);
+        }
+
+        // for objects that something else keeps alive, like the scene_arena they were created in.
+        explicit bvh_node(const std::vector<const hittable*>& objects_) { build(objects_); }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return tree.hit(r, ray_t, [&](std::uint32_t i, interval& t) {
+                if (!objects[i]->hit(r, t, rec)) return false;
+                t.max = rec.t;
+                return true;
+            });
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+    private:
+        bvh_tree tree;
+        std::vector<const hittable*> objects;
+        std::vector<shared_ptr<hittable>> owned; // empty for the raw pointer constructor.
+        aabb bbox;
+
+        void build(const std::vector<const hittable*>& objects_) {
+            std::vector<aabb> boxes;
+            boxes.reserve(objects_.size());
+            for (const auto* object : objects_) boxes.push_back(object->bounding_box());
+            tree.build(boxes);
+
+            // store the objects in leaf order, so a leaf reads neighbouring pointers.
+            objects.reserve(objects_.size());
+            for (auto index : tree.indices) objects.push_back(objects_[index]);
+            std::iota(tree.indices.begin(), tree.indices.end(), 0);
+
+            bbox = tree.bounds();
+        }
+};
+
+#endif
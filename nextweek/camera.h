@@ -11,6 +11,23 @@
 #include "rtweekend.h"
 #include "hittable.h"
 #include "material.h"
+#include "accumulation_buffer.h"
+#include "denoiser.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+#include "tile_scheduler.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 class camera {
     public:
@@ -19,6 +36,7 @@ class camera {
         int image_width = 100;
         int samples_per_pixel = 10; // random samples per each pixel.
         int max_depth = 10; // maximum number of ray bounces into scene.
+        int russian_roulette_depth = 3; // bounces before paths may be cut by russian roulette, 0 turns it off.
 
         double vfov = 90;
         point3 lookfrom = point3(0,0,0); // point camera is looking from.
@@ -28,39 +46,95 @@ class camera {
         double defocus_angle = 0; // variation angle of rays through each pixel.
         double focus_dist = 10; // distance from camera lookfrom point to plane of perfect focus.
 
-        void render(const hittable& world) {
-            
-            initialize();
-
-            // render code.
-            std::cout << "P3\n" << image_width << " " << image_height << "\n255\n";
-
-            /* iterate over all the pixels in the image, compute color for each ray from camera center to pixel_center in image. */
-
-            for (int j = 0; j < image_height; j++) {
-                std::clog << "\rScanlines remaining: " << (image_height -j) << ' ' << std::flush;
-
-                for (int i = 0;i < image_width; i++){
-                    
-                    // sample some rays around this pixel, and average the colors returned by all samples.
-                    color pixel_color(0,0,0);
-                    for (int sample = 0; sample < samples_per_pixel; sample++){
-                        ray r = get_ray(i,j);
-                        pixel_color += ray_color(r, max_depth, world);
-                    }
-
-                    // auto pixel_center = pixel00_loc + (i*pixel_delta_u) + (j*pixel_delta_v);
-                    // auto ray_direction = pixel_center - camera_center;
-                    // ray r(camera_center, ray_direction);
-
-                    // color pixel_color = ray_color(r, world); 
-                    write_color(std::cout, pixel_samples_scale* pixel_color);
-                }
+        int num_threads = 0; // render threads, 0 uses every hardware thread.
+        int tile_size = 16; // width and height of the square tiles handed to each thread.
+        bool show_progress = true; // report tiles (or passes) remaining on std::clog.
+        std::string stats_path; // in RT_STATS builds, the statistics are also written here as JSON.
+        std::string trace_path; // a timeline of the render (tiles per thread, passes, output) goes here, see trace.h.
+
+        // derive every random number from (pixel, sample, bounce, dimension) instead of a
+        // per-thread generator, so the image is identical for any thread count or tile order.
+        bool deterministic_sampling = false;
+        std::uint64_t sampling_seed = 0;
+
+        // where the numbers of a sample come from (see sampler.h). anything but independent
+        // reads them from the per-sample streams too, so it is deterministic as well.
+        sampler_type sampler = sampler_type::independent;
+
+        std::string output_path; // image file render() writes, empty writes to stdout.
+        image_format output_format = image_format::ppm;
+
+        // write the image a band of rows at a time while it renders instead of keeping the
+        // whole framebuffer, so memory grows with band_height rather than with the image size.
+        bool stream_output = false;
+        int band_height = 64; // rows per band when streaming.
+
+        /*
+            progressive rendering: with samples_per_pass > 0 the image is built up in passes of
+            that many samples per pixel. every checkpoint_interval passes the running sums are
+            saved to checkpoint_path (and the image so far to output_path), and a render started
+            with an existing checkpoint picks up where it stopped, so samples_per_pixel can also
+            be raised to refine a finished render (with halton and zsobol only up to the next
+            power of two, their points depend on it). a file at checkpoint_path that isn't a
+            checkpoint of this render stops the render, unless overwrite_checkpoint allows
+            starting over in its place. scene_hash tells the checkpoint which scene it is of
+            (see scene_description::hash), the camera can't see that for itself.
+        */
+        int samples_per_pass = 0;
+        std::string checkpoint_path;
+        int checkpoint_interval = 1;
+        bool overwrite_checkpoint = false;
+        std::uint64_t scene_hash = 0;
+
+        /*
+            adaptive sampling, on top of the progressive passes: a pixel stops receiving samples
+            once it has adaptive_min_samples and its estimated noise after gamma is below
+            noise_target (about 1/255 by default), so samples_per_pixel becomes a per pixel
+            cap. flat sky and diffuse ground settle early and the remaining passes only go to
+            noisy pixels (glass, defocus edges).
+        */
+        bool adaptive_sampling = false;
+        int adaptive_min_samples = 16;
+        double noise_target = 0.004;
+
+        double time_budget = 0; // seconds, progressive renders stop after the pass that uses it up. 0 is no limit.
+
+        /*
+            denoise the finished frame with the a-trous filter in denoiser.h, guided by the
+            albedo and normal each pixel's camera rays see first. only the full frame renders
+            denoise, streamed bands and progressive passes don't have the whole image at hand.
+        */
+        bool denoise = false;
+        denoise_settings denoise_options;
+
+        /*
+            World is either a hittable (virtual dispatch, open to new types) or a closed_scene
+            (closed set of types, dispatched with variants and a switch on the material kind).
+        */
+        template <typename World>
+        void render(const World& world) {
+            // render the image and write it to output_path in output_format.
+            bool owns_trace = start_trace();
+            {
+                trace_span frame(trace, trace.stage_track(), "frame", "camera");
+                render_to_output(world);
             }
-            std::clog << "\rDone.           \n";
-
+            if (owns_trace) finish_trace();
+        }
 
+        template <typename World>
+        void render(const World& world, framebuffer& image) {
+            bool owns_trace = start_trace();
+            render_frame(world, image);
+            if (owns_trace) finish_trace();
+        }
 
+        template <typename World>
+        color render_pixel(const World& world, int i, int j) {
+            // render a single pixel, e.g. to debug it. with deterministic sampling this gives
+            // exactly the value the pixel has in the full frame.
+            initialize();
+            return sample_pixel(i, j, world);
         }
 
     private:
@@ -70,11 +144,96 @@ class camera {
         point3 pixel00_loc; // location of pixel 0,0
         vec3 pixel_delta_u; // offset to pixel to the right.
         vec3 pixel_delta_v; // offset to pixel below.
-        double pixel_samples_scale; // color scale factor for a sum of pixel samples.
+        real pixel_samples_scale; // color scale factor for a sum of pixel samples.
         vec3 u,v,w; // camera frame basis vectors.
 
         vec3 defocus_disk_u; // defocus disk horizontal radius.
         vec3 defocus_disk_v; // defocus disk vertical radius.
+        sample_pattern pattern; // the sampler, set up for this image size and sample count.
+        trace_recorder trace; // records only while a render with a trace_path runs.
+
+        template <typename World>
+        void render_to_output(const World& world) {
+            if (samples_per_pass > 0 || adaptive_sampling) {
+                if (denoise) std::clog << "Progressive renders are not denoised.\n";
+                render_progressive(world);
+                return;
+            }
+
+            std::ofstream file;
+            if (!output_path.empty()) {
+                file.open(output_path, std::ios::binary);
+                if (!file) {
+                    std::clog << "Can't open " << output_path << " for writing.\n";
+                    return;
+                }
+            }
+            std::ostream& out = output_path.empty() ? std::cout : file;
+
+            if (stream_output) {
+                // pfm rows are stored bottom to top, so its bands have to be seeked into place.
+                if (output_format != image_format::pfm || !output_path.empty()) {
+                    if (denoise) std::clog << "Streamed renders are not denoised.\n";
+                    render_streaming(world, out);
+                    return;
+                }
+                std::clog << "Streaming pfm needs an output file, rendering the full frame.\n";
+            }
+
+            framebuffer image;
+            render_frame(world, image);
+            trace_span output(trace, trace.stage_track(), "output", "output");
+            write_image(out, output_format, image);
+        }
+
+        template <typename World>
+        void render_frame(const World& world, framebuffer& image) {
+            initialize();
+
+            /* split the image into tiles and render the tiles in parallel into the framebuffer.
+               the pixels are linear radiance, gamma and quantization happen when it is written. */
+
+            image.resize(image_width, image_height);
+            tile_scheduler scheduler(num_threads);
+            render_progress progress(tile_count(image_height), show_progress);
+
+            if (!denoise) {
+                render_rows(world, scheduler, image, 0, image_height, progress);
+                if (show_progress) std::clog << "\rDone.           \n";
+                report_stats();
+                return;
+            }
+
+            denoise_guides guides(image_width, image_height);
+            render_rows(world, scheduler, image, 0, image_height, progress, &guides);
+
+            auto start_time = std::chrono::steady_clock::now();
+            {
+                trace_span denoising(trace, trace.stage_track(), "denoise", "denoise");
+                atrous_denoiser denoiser(image_width, image_height);
+                denoiser.run(image, guides, scheduler, denoise_options);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+
+            if (show_progress) std::clog << "\rDone, denoised in " << elapsed.count() << " s.\n";
+            report_stats();
+        }
+
+        struct render_progress {
+            int total_tiles;
+            bool show;
+            std::atomic<int> tiles_done{0};
+            std::mutex lock;
+
+            render_progress(int total_tiles_, bool show_) : total_tiles(total_tiles_), show(show_) {}
+
+            void tile_finished() {
+                int remaining = total_tiles - (++tiles_done);
+                if (!show) return;
+                std::lock_guard<std::mutex> guard(lock);
+                std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush;
+            }
+        };
 
         void initialize() {
             // initialize the camera here.
@@ -117,6 +276,293 @@ class camera {
             auto defocus_radius = focus_dist * std::tan(degrees_to_radians(defocus_angle/2));
             defocus_disk_u = u * defocus_radius;
             defocus_disk_v = v * defocus_radius;
+
+            pattern = sample_pattern(sampler, image_width, image_height, samples_per_pixel);
+        }
+
+        void report_stats() const {
+            // prints (and saves) everything counted since the last report.
+#ifdef RT_STATS
+            auto counts = rt_stats::take();
+            rt_stats::print(std::clog, counts);
+            if (stats_path.empty()) return;
+            std::ofstream file(stats_path);
+            if (file) rt_stats::write_json(file, counts);
+            else std::clog << "Can't open " << stats_path << " for writing.\n";
+#endif
+        }
+
+        bool start_trace() {
+            // starts recording if a trace was asked for and a render further up hasn't already.
+            if (trace_path.empty() || trace.active()) return false;
+            trace.start(tile_scheduler(num_threads).thread_count());
+            return true;
+        }
+
+        void finish_trace() {
+            if (!trace.finish(trace_path)) std::clog << "Can't write trace " << trace_path << ".\n";
+        }
+
+        bool use_streams() const {
+            return deterministic_sampling || sampler != sampler_type::independent;
+        }
+
+        int tile_count(int rows) const {
+            int ts = std::max(tile_size, 1);
+            return ((image_width + ts - 1) / ts) * ((rows + ts - 1) / ts);
+        }
+
+        template <typename World>
+        void render_rows(const World& world, const tile_scheduler& scheduler, framebuffer& image,
+                int y0, int y1, render_progress& progress,
+                denoise_guides* guides = nullptr) {
+            // render image rows [y0, y1) in parallel tiles. row y0 goes to row 0 of image.
+            // with guides given, also fills in what the denoiser needs to know about each pixel.
+            auto tiles = make_tiles(image_width, y1 - y0, tile_size);
+
+            scheduler.run(tiles, [&](const tile& t, int worker) {
+                trace_span span(trace, worker, "tile", "render",
+                    {{"x0", t.x0}, {"y0", y0 + t.y0}, {"x1", t.x1}, {"y1", y0 + t.y1}});
+                for (int j = t.y0; j < t.y1; j++) {
+                    for (int i = t.x0; i < t.x1; i++) {
+                        if (!guides) {
+                            image.set(i, j, sample_pixel(i, y0 + j, world));
+                            continue;
+                        }
+                        guide_sample guide_sum;
+                        double luminance_sq_sum = 0;
+                        color sum = sample_sum(i, y0 + j, world, 0, samples_per_pixel, use_streams(),
+                            &luminance_sq_sum, &guide_sum);
+                        image.set(i, j, pixel_samples_scale * sum);
+                        guides->set(i, j, sum, luminance_sq_sum, guide_sum, samples_per_pixel);
+                    }
+                }
+                progress.tile_finished();
+            });
+        }
+
+        template <typename World>
+        void render_streaming(const World& world, std::ostream& out) {
+            /*
+                render bands of band_height rows top to bottom. each finished band goes to a
+                writer thread, which encodes and writes it while the next band renders, so only
+                two bands are ever in memory.
+            */
+            initialize();
+
+            int rows_per_band = std::clamp(band_height, 1, image_height);
+            framebuffer bands[2] = {framebuffer(image_width, rows_per_band),
+                                    framebuffer(image_width, rows_per_band)};
+
+            image_writer writer(out, output_format, image_width, image_height);
+            tile_scheduler scheduler(num_threads);
+
+            int total_tiles = 0;
+            for (int y0 = 0; y0 < image_height; y0 += rows_per_band)
+                total_tiles += tile_count(std::min(rows_per_band, image_height - y0));
+            render_progress progress(total_tiles, show_progress);
+
+            std::thread writing;
+            for (int y0 = 0, b = 0; y0 < image_height; y0 += rows_per_band, b++) {
+                int rows = std::min(rows_per_band, image_height - y0);
+                framebuffer& band = bands[b % 2];
+                {
+                    trace_span span(trace, trace.stage_track(), "band", "camera", {{"y0", y0}, {"y1", y0 + rows}});
+                    render_rows(world, scheduler, band, y0, y0 + rows, progress);
+                }
+
+                // the previous band must be out before this one is queued (and before its
+                // buffer is rendered into again on the next iteration).
+                if (writing.joinable()) writing.join();
+                writing = std::thread([this, &writer, &band, y0, rows] {
+                    trace_span span(trace, trace.writer_track(), "write band", "output", {{"y0", y0}, {"y1", y0 + rows}});
+                    writer.write_rows(band.row(0), rows);
+                });
+            }
+            if (writing.joinable()) writing.join();
+            writer.finish();
+
+            if (show_progress) std::clog << "\rDone.           \n";
+            report_stats();
+        }
+
+        bool write_output(const framebuffer& image) const {
+            if (output_path.empty()) {
+                write_image(std::cout, output_format, image);
+                return true;
+            }
+            std::ofstream file(output_path, std::ios::binary);
+            if (!file) {
+                std::clog << "Can't open " << output_path << " for writing.\n";
+                return false;
+            }
+            write_image(file, output_format, image);
+            return true;
+        }
+
+        template <typename World>
+        void render_progressive(const World& world) {
+            initialize();
+
+            accumulation_buffer accum(image_width, image_height);
+            checkpoint_key key{sampling_seed, sampler, pattern.layout_log2_spp(), scene_hash,
+                {lookfrom.x(), lookfrom.y(), lookfrom.z(), lookat.x(), lookat.y(), lookat.z(),
+                 vup.x(), vup.y(), vup.z(), vfov, defocus_angle, focus_dist},
+                {max_depth, russian_roulette_depth}};
+            if (!checkpoint_path.empty()) {
+                std::string error;
+                auto status = accum.load(checkpoint_path, key, error);
+                if (status == checkpoint_status::loaded)
+                    std::clog << "Resuming from " << checkpoint_path << " at " << accum.min_count() << " samples.\n";
+                else if (status == checkpoint_status::incompatible && overwrite_checkpoint)
+                    std::clog << "Starting over, " << checkpoint_path << " (" << error << ") will be overwritten.\n";
+                else if (status == checkpoint_status::incompatible) {
+                    std::clog << "Can't resume from " << checkpoint_path << ": " << error
+                              << ". Not overwriting it, pass --overwrite-checkpoint to start over.\n";
+                    return;
+                }
+            }
+
+            int pass_samples = samples_per_pass > 0 ? samples_per_pass : 8;
+            /*
+                a pixel is finished at samples_per_pixel, or (adaptive) once the noise estimates
+                of it and its 8 neighbours are all below noise_target. a handful of samples can
+                miss a rare bright path completely and look converged; checking the neighbours
+                keeps such pixels going as long as the pixels next to them are still noisy.
+            */
+            std::vector<double> error(accum.count.size());
+            std::vector<unsigned char> finished(accum.count.size());
+            auto update_finished = [&] {
+                for (size_t p = 0; p < error.size(); p++)
+                    error[p] = int(accum.count[p]) >= adaptive_min_samples ? accum.display_error(p) : infinity;
+
+                int remaining = 0;
+                for (int j = 0; j < image_height; j++) {
+                    for (int i = 0; i < image_width; i++) {
+                        size_t p = accum.pixel_index(i, j);
+                        bool done = int(accum.count[p]) >= samples_per_pixel;
+                        if (!done && adaptive_sampling) {
+                            double worst = 0;
+                            for (int y = std::max(j - 1, 0); y <= std::min(j + 1, image_height - 1); y++)
+                                for (int x = std::max(i - 1, 0); x <= std::min(i + 1, image_width - 1); x++)
+                                    worst = std::max(worst, error[accum.pixel_index(x, y)]);
+                            done = worst <= noise_target;
+                        }
+                        finished[p] = done;
+                        if (!done) remaining++;
+                    }
+                }
+                return remaining;
+            };
+
+            auto tiles = make_tiles(image_width, image_height, tile_size);
+            tile_scheduler scheduler(num_threads);
+            framebuffer image;
+            auto start_time = std::chrono::steady_clock::now();
+
+            int remaining = update_finished();
+            for (int pass = 1; remaining > 0; pass++) {
+                trace_span pass_span(trace, trace.stage_track(), "pass", "camera",
+                    {{"number", pass}, {"pixels_remaining", remaining}});
+                scheduler.run(tiles, [&](const tile& t, int worker) {
+                    trace_span span(trace, worker, "tile", "render",
+                        {{"x0", t.x0}, {"y0", t.y0}, {"x1", t.x1}, {"y1", t.y1}});
+                    for (int j = t.y0; j < t.y1; j++) {
+                        for (int i = t.x0; i < t.x1; i++) {
+                            size_t p = accum.pixel_index(i, j);
+                            if (finished[p]) continue;
+
+                            // a pixel short of adaptive_min_samples is first brought up to it.
+                            int first = int(accum.count[p]);
+                            int count = std::max(pass_samples, adaptive_sampling ? adaptive_min_samples - first : 0);
+                            count = std::min(count, samples_per_pixel - first);
+
+                            // passes rely on sample n of a pixel being the same whenever it is
+                            // taken, which the per thread generators can't give, so progressive
+                            // renders always use the streams.
+                            double luminance_sq_sum = 0;
+                            color sum = sample_sum(i, j, world, first, count, true, &luminance_sq_sum);
+                            accum.add(i, j, sum, luminance_sq_sum, count);
+                        }
+                    }
+                });
+
+                remaining = update_finished();
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+                bool out_of_time = time_budget > 0 && elapsed.count() >= time_budget;
+                bool last = remaining == 0 || out_of_time;
+
+                if (show_progress)
+                    std::clog << "\rPass " << pass << ", pixels remaining: " << remaining << "    " << std::flush;
+
+                if (!checkpoint_path.empty() && (last || pass % std::max(1, checkpoint_interval) == 0)) {
+                    trace_span span(trace, trace.stage_track(), "checkpoint", "output");
+                    if (!accum.save(checkpoint_path, key))
+                        std::clog << "\nCan't write checkpoint " << checkpoint_path << ".\n";
+                    if (!last && !output_path.empty()) {
+                        accum.resolve(image);
+                        write_output(image);
+                    }
+                }
+
+                if (out_of_time) {
+                    std::clog << "\nTime budget used up.\n";
+                    break;
+                }
+            }
+
+            double total_samples = 0;
+            for (auto n : accum.count) total_samples += n;
+            std::clog << "\nAverage samples per pixel: " << total_samples / accum.count.size() << '\n';
+
+            {
+                trace_span span(trace, trace.stage_track(), "output", "output");
+                accum.resolve(image);
+                write_output(image);
+            }
+
+            std::clog << "Done.\n";
+            report_stats();
+        }
+
+        template <typename World>
+        color sample_pixel(int i, int j, const World& world) const {
+            // sample some rays around this pixel, and average the colors returned by all samples.
+            return pixel_samples_scale * sample_sum(i, j, world, 0, samples_per_pixel, use_streams());
+        }
+
+        template <typename World>
+        color sample_sum(int i, int j, const World& world, int first_sample, int count, bool streams,
+                double* luminance_sq_sum = nullptr, guide_sample* guide_sum = nullptr) const {
+            // the sum (not the average) of samples [first_sample, first_sample + count) of pixel i,j,
+            // with random numbers from the per-sample streams if streams is set.
+            // also adds up the squared luminance of each sample if luminance_sq_sum is given, and
+            // the first hit albedo and normal of each sample if guide_sum is.
+            auto& rand_state = thread_random();
+            rand_state.use_stream = streams;
+            rand_state.stream.pattern = pattern;
+
+            color pixel_color(0,0,0);
+            for (int sample = first_sample; sample < first_sample + count; sample++){
+                if (rand_state.use_stream)
+                    rand_state.stream.start(sampling_seed, std::uint32_t(j)*image_width + i, sample);
+                ray r = get_ray(i,j);
+                RT_STAT_COUNT(camera_rays);
+                guide_sample guide;
+                color sample_color = ray_color(r, world, streams, guide_sum ? &guide : nullptr);
+                pixel_color += sample_color;
+                if (guide_sum) {
+                    guide_sum->albedo += guide.albedo;
+                    guide_sum->normal += guide.normal;
+                }
+                if (luminance_sq_sum) {
+                    auto y = luminance(sample_color);
+                    *luminance_sq_sum += y*y;
+                }
+            }
+
+            rand_state.use_stream = false;
+            return pixel_color;
         }
 
         vec3 sample_square() const {
@@ -138,32 +584,100 @@ class camera {
             
         }
 
-        color ray_color (const ray& r, int depth, const hittable& world) {
-
-            if (depth <= 0) return color(0,0,0); // if we've exceeded ray bounce limit, no more light is gathered.
+        template <typename World>
+        static bool scatter(const World& world, const ray& r_in, const hit_record& rec,
+                color& attenuation, ray& scattered) {
+            if constexpr (std::is_base_of_v<hittable, World>)
+                return rec.mat->scatter(r_in, rec, attenuation, scattered);
+            else
+                return world.scatter(r_in, rec, attenuation, scattered);
+        }
 
-            hit_record rec;
+        template <typename World>
+        color ray_color (const ray& camera_ray, const World& world, bool streams, guide_sample* guide = nullptr) const {
+            /*
+                iterative path tracer. instead of recursing once per bounce, carry the product
+                of all attenuations so far (the path throughput) and multiply the sky color
+                into it when the path escapes. guide, if given, gets the albedo and normal the
+                camera ray sees for the denoiser. streams is sample_sum's, with it every bounce
+                moves the sample's stream on to that bounce's numbers.
+            */
+            ray r = camera_ray;
+            color throughput(1,1,1);
+
+            // mirrors and glass show what they reflect, so the guides are taken past them from
+            // the first diffuse hit, tinted by the specular bounces on the way.
+            bool guide_pending = guide != nullptr;
+
+            for (int bounce = 1; bounce <= max_depth; bounce++) {
+                // bounce 0 is the camera ray itself, scattering at the first hit is bounce 1.
+                if (streams) thread_random().stream.set_bounce(std::uint32_t(bounce));
+
+                hit_record rec;
+
+                // if the ray hits any objects in the world.
+                /* 0.001 skips hits right at the ray origin: the rounded hit point the ray starts from can
+                   sit just below the surface it left, which would then be hit again (shadow acne). */
+                bool hit_anything = world.hit(r, interval(0.001, infinity), rec);
+                RT_STAT_COUNT(rays);
+                RT_STAT_END_RAY();
+                if (!hit_anything) {
+                    // ray doesn't hit any objects, return the color according
+                    // to the gradient.
+                    RT_STAT_COUNT(sky_hits);
+                    RT_STAT_RECORD(path_depth, bounce);
+                    vec3 unit_direction = unit_vector(r.direction());
+                    auto a = 0.5 * (unit_direction.y() + 1.0);
+                    color sky = (1.0 -a)* color(1.0,1.0,1.0) + a*color(0.5, 0.7, 1.0);
+                    if (guide_pending) {
+                        // the sky is its own albedo, and faces the camera.
+                        guide->albedo = throughput * sky;
+                        guide->normal = -unit_direction;
+                    }
+                    return throughput * sky;
+                }
 
-            // if the ray hits any objects in the world.
-            /* the reason for 0.001 in the interval is still not understood, related to some shadow acne.*/
-            if (world.hit(r, interval(0.001, infinity), rec)) {
                 ray scattered;
                 color attenuation;
-                if (rec.mat->scatter(r, rec, attenuation, scattered))
-                    return attenuation * ray_color(scattered, depth-1, world);
-                return color(0,0,0);
-                // // vec3 direction = random_on_hemisphere(rec.normal);
-                // vec3 direction = rec.normal + random_unit_vector();
-                // // return 0.5 * (rec.normal + color(1,1,1));
-                // return 0.5 * ray_color(ray(rec.p, direction), depth-1, world); // return only 50% of the color of ray from a bounce. 
-            }
+                bool scattering = scatter(world, r, rec, attenuation, scattered);
+                if (guide_pending && (!scattering || (rec.mat->kind != material_kind::metal
+                                                      && rec.mat->kind != material_kind::dielectric))) {
+                    guide->albedo = scattering ? throughput * attenuation : color(0,0,0);
+                    guide->normal = rec.normal;
+                    guide_pending = false;
+                }
+                if (!scattering) {
+                    RT_STAT_RECORD(path_depth, bounce);
+                    return color(0,0,0);
+                }
 
-            // ray doesn't hit any objects, return the color according
-            // to the gradient.
+                throughput = throughput * attenuation;
+                r = scattered;
+                if constexpr (robust_geometry)
+                    r = ray(offset_ray_origin(rec.p, rec.normal, r.direction()), r.direction());
+
+                /*
+                    russian roulette: past a few bounces, keep the path alive with probability p
+                    equal to its largest throughput component and divide the survivors by p.
+                    the estimate stays unbiased, but dim paths that can barely contribute stop
+                    early instead of running all the way to max_depth.
+                */
+                if (russian_roulette_depth > 0 && bounce >= russian_roulette_depth) {
+                    auto p = std::fmax(throughput.x(), std::fmax(throughput.y(), throughput.z()));
+                    if (p < 1) {
+                        if (random_double() >= p) {
+                            RT_STAT_COUNT(roulette_terminations);
+                            RT_STAT_RECORD(path_depth, bounce);
+                            return color(0,0,0);
+                        }
+                        throughput = throughput / p;
+                    }
+                }
+            }
 
-            vec3 unit_direction = unit_vector(r.direction());
-            auto a = 0.5 * (unit_direction.y() + 1.0);
-            return (1.0 -a)* color(1.0,1.0,1.0) + a*color(0.5, 0.7, 1.0);
+            RT_STAT_COUNT(depth_limit_terminations);
+            RT_STAT_RECORD(path_depth, max_depth);
+            return color(0,0,0); // if we've exceeded ray bounce limit, no more light is gathered.
         }
 
         point3 defocus_disk_sample() const {
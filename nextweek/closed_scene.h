@@ -0,0 +1,135 @@
+#ifndef CLOSED_SCENE_H
+#define CLOSED_SCENE_H
+
+/*
+    Scene representation for a closed, compile-time set of types.
+
+    hittable_list and material work through virtual calls, so any new type
+    can be plugged in, but nothing on the hot path can be inlined. A
+    closed_scene only holds the primitive types listed in closed_primitive
+    (a std::variant, stored by value; a mesh_shape points at a mesh and an
+    instances_shape at an instance_tree the scene keeps) and the built in
+    materials (stored grouped by type), and dispatches with std::visit and
+    a switch on material_kind. The camera renders either representation,
+    which lets the two be benchmarked against each other on the same
+    scene.
+
+    Instanced geometry is a closed_scene of its own, one per object, whose
+    primitives use the materials of the scene holding the instances.
+*/
+
+#include "rtweekend.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "instance.h"
+#include "material.h"
+#include "mesh.h"
+#include "sphere.h"
+
+#include <deque>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+class closed_scene;
+
+class instances_shape {
+    // the instances of an instance_tree of closed_scenes, see instance.h. the tree is
+    // owned elsewhere and has to be built already.
+
+    public:
+        const instance_tree<closed_scene>* instances;
+
+        explicit instances_shape(const instance_tree<closed_scene>* instances_) : instances(instances_) {}
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const;
+        aabb bounding_box() const { return instances->bounding_box(); }
+};
+
+using closed_primitive = std::variant<sphere_shape, mesh_shape, instances_shape>;
+
+class closed_scene {
+    public:
+        // materials are kept per type. deques never move their elements, so the
+        // pointers stored in primitives stay valid as materials are added.
+        std::deque<lambertian> lambertians;
+        std::deque<metal> metals;
+        std::deque<dielectric> dielectrics;
+
+        std::vector<closed_primitive> primitives;
+        std::vector<shared_ptr<const triangle_mesh>> meshes; // the geometry of the mesh_shapes.
+        std::vector<shared_ptr<const instance_tree<closed_scene>>> instance_trees; // of the instances_shapes.
+
+        template <typename M>
+        const material* add_material(const M& mat) {
+            if constexpr (std::is_same_v<M, lambertian>) return &lambertians.emplace_back(mat);
+            else if constexpr (std::is_same_v<M, metal>) return &metals.emplace_back(mat);
+            else {
+                static_assert(std::is_same_v<M, dielectric>, "closed_scene only holds the built in materials");
+                return &dielectrics.emplace_back(mat);
+            }
+        }
+
+        void add(const closed_primitive& primitive) {
+            primitives.push_back(primitive);
+            tree.nodes.clear(); // the bvh no longer covers every primitive.
+        }
+
+        void add(shared_ptr<const triangle_mesh> geometry, const material* mat) {
+            // the mesh is kept alive here, its mesh_shape only points at it.
+            meshes.push_back(geometry);
+            add(mesh_shape(geometry.get(), mat));
+        }
+
+        void add(shared_ptr<const instance_tree<closed_scene>> instances) {
+            // a built instance tree, kept alive here like a mesh.
+            instance_trees.push_back(instances);
+            add(instances_shape(instances.get()));
+        }
+
+        void build() {
+            // build the bvh over the primitives, in leaf order like bvh_node.
+            std::vector<aabb> boxes;
+            boxes.reserve(primitives.size());
+            for (const auto& primitive : primitives)
+                boxes.push_back(std::visit([](const auto& p) { return p.bounding_box(); }, primitive));
+            tree.build(boxes);
+
+            std::vector<closed_primitive> ordered;
+            ordered.reserve(primitives.size());
+            for (auto index : tree.indices) ordered.push_back(primitives[index]);
+            primitives.swap(ordered);
+            std::iota(tree.indices.begin(), tree.indices.end(), 0);
+        }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+            auto hit_primitive = [&](std::uint32_t i, interval& t) {
+                bool hit = std::visit([&](const auto& p) { return p.hit(r, t, rec); }, primitives[i]);
+                if (hit) t.max = rec.t;
+                return hit;
+            };
+
+            if (!tree.nodes.empty()) return tree.hit(r, ray_t, hit_primitive);
+
+            // not built yet, fall back to testing everything.
+            bool hit_anything = false;
+            for (std::uint32_t i = 0; i < primitives.size(); i++)
+                if (hit_primitive(i, ray_t)) hit_anything = true;
+            return hit_anything;
+        }
+
+        aabb bounding_box() const { return tree.bounds(); } // once built.
+
+        static bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) {
+            return scatter_closed(*rec.mat, r_in, rec, attenuation, scattered);
+        }
+
+    private:
+        bvh_tree tree;
+};
+
+inline bool instances_shape::hit(const ray& r, interval ray_t, hit_record& rec) const {
+    return instances->hit(r, ray_t, rec);
+}
+
+#endif
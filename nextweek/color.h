@@ -3,6 +3,9 @@
 
 #include "interval.h"
 #include "vec3.h"
+#include "simd.h"
+
+#include <cstddef>
 
 using color = vec3;
 
@@ -11,23 +14,37 @@ inline double linear_to_gamma(double linear_component) {
     return 0;
 }
 
-void write_color(std::ostream& out, const color& pixel_color) {
-    auto r = pixel_color.x();
-    auto g = pixel_color.y();
-    auto b = pixel_color.z();
-
-    r = linear_to_gamma(r);
-    g = linear_to_gamma(g);
-    b = linear_to_gamma(b);
+inline double luminance(const color& c) {
+    // rec. 709 luminance of a linear color.
+    return 0.2126*c.x() + 0.7152*c.y() + 0.0722*c.z();
+}
 
-    // Translate the [0,1] component values to the byte range [0,255].
-    static const interval intensity(0.000, 0.999);
-    int rbyte = int(255.999 * intensity.clamp(r));
-    int gbyte = int(255.999 * intensity.clamp(g));
-    int bbyte = int(255.999 * intensity.clamp(b));
+inline unsigned char linear_to_byte(float linear_component) {
+    // gamma 2, then translate the [0,1] component value to the byte range [0,255].
+    static const interval_t<float> intensity(0.000f, 0.999f);
+    float gamma = linear_component > 0 ? std::sqrt(linear_component) : 0.0f;
+    return (unsigned char)(255.999f * intensity.clamp(gamma));
+}
 
-    // Write out the pixel color components.
-    out << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
+inline void linear_to_bytes(const float* linear, unsigned char* out, size_t n) {
+    /*
+        linear_to_byte over a whole buffer of components, simd_float::width at a time.
+        simd_max against 0 also turns NaN into 0, the same as the scalar version, so
+        it doesn't matter which components land in the scalar tail.
+    */
+    using vf = simd_float;
+    const auto zero = vf::broadcast(0.0f);
+    const auto top = vf::broadcast(0.999f);
+    const auto scale = vf::broadcast(255.999f);
+
+    float block[vf::width];
+    size_t k = 0;
+    for (; k + vf::width <= n; k += vf::width) {
+        auto gamma = simd_sqrt(simd_max(vf::load(linear + k), zero));
+        (simd_min(gamma, top) * scale).store(block);
+        for (int lane = 0; lane < vf::width; lane++) out[k + lane] = (unsigned char)(block[lane]);
+    }
+    for (; k < n; k++) out[k] = linear_to_byte(linear[k]);
 }
 
-#endif
\ No newline at end of file
+#endif
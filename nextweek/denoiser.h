@@ -0,0 +1,214 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+/*
+    Edge-avoiding a-trous wavelet denoiser (Dammertz et al., 2010, with the
+    variance guided color weight of SVGF, Schied et al., 2017).
+
+    The image is blurred with a 5x5 B3 spline kernel whose taps are spread
+    1, 2, 4, 8, 16 pixels apart in successive passes, so five passes cover
+    a 61x61 footprint at 25 taps per pixel each. Every tap is weighted by
+    how similar it is to the center pixel, so the blur stops at edges:
+
+        normal: the first hit normal, weight max(0, n_p . n_q)^32.
+        albedo: the first hit albedo, weight falls off with the difference.
+        color:  the luminance difference, measured in standard deviations
+                of the center pixel's noise. the noise estimate is filtered
+                along with the color, so it shrinks every pass and the wide
+                passes only average pixels that already agree.
+
+    Color is divided by albedo before filtering and multiplied back after,
+    so the filter smooths lighting noise without blurring textures and
+    sphere colors into each other.
+
+    Planes are stored one per channel with a border wide enough for the
+    widest pass. Border normals are 0, which gives outside taps zero
+    weight, so the inner loop runs simd_float::width pixels at a time with
+    no bounds checks. Rows are split over the tile scheduler's threads.
+*/
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "simd.h"
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <vector>
+
+struct guide_sample {
+    // what the denoiser needs from the first hit of a camera ray.
+    color albedo = color(0,0,0);
+    vec3 normal = vec3(0,0,0);
+};
+
+class denoise_guides {
+    // per pixel inputs of the denoiser, besides the noisy image itself.
+    public:
+        framebuffer albedo;
+        framebuffer normal;
+        std::vector<float> variance; // variance of each pixel's mean luminance.
+
+        denoise_guides(int width, int height)
+            : albedo(width, height), normal(width, height), variance(size_t(width) * height, 0.0f) {}
+
+        void set(int i, int j, const color& sample_sum, double luminance_sq_sum, const guide_sample& guide_sum,
+                int samples) {
+            // from the sums over the samples of pixel (i,j), as camera::sample_sum adds them up.
+            double n = samples;
+            albedo.set(i, j, guide_sum.albedo / n);
+            normal.set(i, j, guide_sum.normal / n);
+            double mean = luminance(sample_sum) / n;
+            double sample_variance = n > 1 ? std::max(0.0, (luminance_sq_sum - n*mean*mean) / (n - 1)) : mean*mean;
+            variance[size_t(j)*albedo.width + i] = float(sample_variance / n);
+        }
+};
+
+struct denoise_settings {
+    int passes = 5;
+    float sigma_color = 4.0f; // luminance differences beyond this many standard deviations get no weight.
+    float sigma_albedo = 0.1f;
+};
+
+class atrous_denoiser {
+    public:
+        atrous_denoiser(int width_, int height_) : width(width_), height(height_) {
+            // rows are rounded up to whole simd vectors, the extra lanes sit in the border.
+            int padded_width = (width + simd_float::width - 1) / simd_float::width * simd_float::width;
+            stride = padded_width + 2*border;
+            size_t plane_size = size_t(stride) * (height + 2*border);
+            for (auto* planes : {color_in, color_out, albedo, normal})
+                for (int k = 0; k < 3; k++) planes[k].assign(plane_size, 0.0f);
+            variance_in.assign(plane_size, 0.0f);
+            variance_out.assign(plane_size, 0.0f);
+        }
+
+        void run(framebuffer& image, const denoise_guides& guides, const tile_scheduler& scheduler,
+                const denoise_settings& settings = {}) {
+            load(image, guides);
+
+            // bands of rows, each pass waits for the previous one to finish completely.
+            std::vector<tile> bands;
+            for (int y = 0; y < height; y += 8) bands.push_back({0, y, width, std::min(y + 8, height)});
+
+            for (int pass = 0; pass < std::min(settings.passes, max_passes); pass++) {
+                int step = 1 << pass;
+                scheduler.run(bands, [&](const tile& band, int) {
+                    for (int y = band.y0; y < band.y1; y++) filter_row(y, step, settings);
+                });
+                std::swap(color_in, color_out);
+                std::swap(variance_in, variance_out);
+            }
+
+            store(image);
+        }
+
+    private:
+        static constexpr int max_passes = 5;
+        static constexpr int border = 2 << (max_passes - 1); // 2 taps at the widest spacing.
+
+        int width, height;
+        int stride; // floats per padded row.
+        std::vector<float> color_in[3], color_out[3], albedo[3], normal[3];
+        std::vector<float> variance_in, variance_out;
+
+        size_t index(int i, int j) const { return size_t(j + border) * stride + (i + border); }
+
+        static float demodulation(float albedo) {
+            // dark albedos are left alone rather than blowing up the noise.
+            return albedo > 1e-3f ? albedo : 1.0f;
+        }
+
+        void load(const framebuffer& image, const denoise_guides& guides) {
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    size_t p = index(i, j);
+                    color c = image.get(i, j), a = guides.albedo.get(i, j), n = guides.normal.get(i, j);
+                    auto length = n.length();
+                    for (int k = 0; k < 3; k++) {
+                        // demodulate: filter the lighting, not the surface color.
+                        albedo[k][p] = float(a[k]);
+                        color_in[k][p] = float(c[k]) / demodulation(float(a[k]));
+                        normal[k][p] = length > 0 ? float(n[k] / length) : 0.0f;
+                    }
+                    // the luminance variance scales with the square of the demodulation too.
+                    float l = float(luminance(color(demodulation(float(a[0])), demodulation(float(a[1])),
+                                                    demodulation(float(a[2])))));
+                    variance_in[p] = guides.variance[size_t(j)*width + i] / (l*l);
+                }
+            }
+        }
+
+        void store(framebuffer& image) const {
+            for (int j = 0; j < height; j++) {
+                for (int i = 0; i < width; i++) {
+                    size_t p = index(i, j);
+                    auto channel = [&](int k) { return color_in[k][p] * demodulation(albedo[k][p]); };
+                    image.set(i, j, color(channel(0), channel(1), channel(2)));
+                }
+            }
+        }
+
+        void filter_row(int y, int step, const denoise_settings& settings) {
+            using vf = simd_float;
+            static const float kernel[5] = {1.0f/16, 1.0f/4, 3.0f/8, 1.0f/4, 1.0f/16};
+
+            const auto zero = vf::broadcast(0.0f);
+            const auto one = vf::broadcast(1.0f);
+            const auto sigma_color_sq = vf::broadcast(settings.sigma_color * settings.sigma_color);
+            const auto inv_albedo = vf::broadcast(1.0f / (settings.sigma_albedo * settings.sigma_albedo));
+            const auto tiny = vf::broadcast(1e-10f);
+            const auto luma_r = vf::broadcast(0.2126f), luma_g = vf::broadcast(0.7152f), luma_b = vf::broadcast(0.0722f);
+
+            // lanes past the right edge of the image land in the border. their normals are 0, so
+            // they keep their 0 color and never weigh in on an image pixel.
+            for (int x = 0; x < width; x += vf::width) {
+                size_t p = index(x, y);
+                vf c[3], a[3], n[3];
+                for (int k = 0; k < 3; k++) {
+                    c[k] = vf::load(&color_in[k][p]);
+                    a[k] = vf::load(&albedo[k][p]);
+                    n[k] = vf::load(&normal[k][p]);
+                }
+                auto l = luma_r*c[0] + luma_g*c[1] + luma_b*c[2];
+                auto inv_color = one / (sigma_color_sq * vf::load(&variance_in[p]) + tiny);
+
+                vf sum[3] = {zero, zero, zero};
+                vf weight_sum = zero, variance_sum = zero;
+                for (int dy = -2; dy <= 2; dy++) {
+                    for (int dx = -2; dx <= 2; dx++) {
+                        size_t q = p + std::ptrdiff_t(dy*step) * stride + dx*step;
+                        vf cq[3], d_albedo = zero, n_dot = zero;
+                        for (int k = 0; k < 3; k++) {
+                            cq[k] = vf::load(&color_in[k][q]);
+                            auto da = vf::load(&albedo[k][q]) - a[k];
+                            d_albedo = d_albedo + da*da;
+                            n_dot = n_dot + n[k] * vf::load(&normal[k][q]);
+                        }
+                        auto dl = luma_r*cq[0] + luma_g*cq[1] + luma_b*cq[2] - l;
+
+                        // max(0, n.n')^32 by repeated squaring.
+                        auto w_normal = simd_max(n_dot, zero);
+                        for (int s = 0; s < 5; s++) w_normal = w_normal * w_normal;
+                        auto w_color = simd_max(one - dl*dl * inv_color, zero);
+                        auto w_albedo = simd_max(one - d_albedo * inv_albedo, zero);
+                        auto w = vf::broadcast(kernel[dx + 2] * kernel[dy + 2]) * w_normal * w_color * w_albedo;
+
+                        for (int k = 0; k < 3; k++) sum[k] = sum[k] + w * cq[k];
+                        weight_sum = weight_sum + w;
+                        variance_sum = variance_sum + w*w * vf::load(&variance_in[q]);
+                    }
+                }
+
+                // the center tap always has weight unless the pixel has no normal (the border),
+                // those keep what they have.
+                auto has_weight = zero < weight_sum;
+                auto inv_weight = one / simd_select(has_weight, weight_sum, one);
+                for (int k = 0; k < 3; k++)
+                    simd_select(has_weight, sum[k] * inv_weight, c[k]).store(&color_out[k][p]);
+                auto variance = variance_sum * inv_weight * inv_weight;
+                simd_select(has_weight, variance, vf::load(&variance_in[p])).store(&variance_out[p]);
+            }
+        }
+};
+
+#endif
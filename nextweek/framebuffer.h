@@ -0,0 +1,48 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+/*
+    Linear radiance image the camera renders into. Pixels are stored as
+    interleaved float rgb, rows top to bottom, with no gamma or clamping
+    applied; that only happens when an image file is written (see
+    image_writer.h), so the same buffer can also be saved as HDR.
+*/
+
+#include "rtweekend.h"
+
+#include <vector>
+
+class framebuffer {
+    public:
+        int width = 0;
+        int height = 0;
+        std::vector<float> pixels; // 3 floats per pixel.
+
+        framebuffer() {}
+
+        framebuffer(int width_, int height_) { resize(width_, height_); }
+
+        void resize(int width_, int height_) {
+            width = width_;
+            height = height_;
+            pixels.assign(size_t(width) * height * 3, 0.0f);
+        }
+
+        void set(int i, int j, const color& c) {
+            float* p = &pixels[(size_t(j)*width + i) * 3];
+            p[0] = float(c.x());
+            p[1] = float(c.y());
+            p[2] = float(c.z());
+        }
+
+        color get(int i, int j) const {
+            const float* p = &pixels[(size_t(j)*width + i) * 3];
+            return color(p[0], p[1], p[2]);
+        }
+
+        // first component of row j, rows are contiguous.
+        float* row(int j) { return &pixels[size_t(j)*width*3]; }
+        const float* row(int j) const { return &pixels[size_t(j)*width*3]; }
+};
+
+#endif
@@ -1,15 +1,19 @@
 #ifndef HITTABLE_H
 #define HITTABLE_H
 
+#include "aabb.h"
+
+#include <type_traits>
+
 class material;
 
 class hit_record {
     public:
         point3 p;
         vec3 normal;
-        double t;
+        real t;
+        const material* mat; // non-owning, materials are owned by the scene's material_table.
         bool front_face;
-        shared_ptr<material> mat;
 
         void set_face_normal(const ray& r, const vec3& outward_normal) {
             /*
@@ -28,10 +32,17 @@ class hit_record {
         }
 };
 
+// hit records are copied around on every closest-hit update, keep them a plain block of bytes.
+static_assert(std::is_trivially_copyable_v<hit_record>);
+
 class hittable {
     public:
         virtual ~hittable() = default;
+
+        // on a hit inside ray_t fills rec and returns true. rec is left untouched on a miss.
         virtual bool hit(const ray& r, interval ray_t, hit_record& rec) const = 0;
+
+        virtual aabb bounding_box() const = 0; // box enclosing the object, used to build the bvh.
 };
 
 #endif
\ No newline at end of file
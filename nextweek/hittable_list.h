@@ -17,23 +17,25 @@ class hittable_list : public hittable {
 
         hittable_list(shared_ptr<hittable> object) {add(object);}
 
-        void add(shared_ptr<hittable> object) { objects.push_back(object); }
+        void add(shared_ptr<hittable> object) {
+            objects.push_back(object);
+            bbox = aabb(bbox, object->bounding_box());
+        }
 
-        void clear() { objects.clear();}
+        void clear() { objects.clear(); bbox = aabb(); }
 
         bool hit (const ray& r, interval ray_t, hit_record &rec) const override {
             auto closest_so_far = ray_t.max;
             bool hit_anything = false;
-            hit_record temp_rec;
 
 
             // find a closest object that this ray can hit among all the objects. 
+            // misses leave rec alone and every hit is closer than the last, so objects write rec directly.
 
             for (const auto& object : objects) {
-                if (object->hit(r, interval(ray_t.min, closest_so_far), temp_rec)) {
+                if (object->hit(r, interval(ray_t.min, closest_so_far), rec)) {
                     hit_anything = true;
-                    closest_so_far = temp_rec.t;
-                    rec = temp_rec;
+                    closest_so_far = rec.t;
                 }
             }
 
@@ -41,6 +43,10 @@ class hittable_list : public hittable {
 
         }
 
+        aabb bounding_box() const override { return bbox; }
+
+    private:
+        aabb bbox;
 };
 
 #endif
\ No newline at end of file
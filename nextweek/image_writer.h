@@ -0,0 +1,260 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+/*
+    Image file writers for the linear float rows of a framebuffer.
+
+        ppm: binary P6, 8 bits per channel.
+        png: 8 bit rgb. the zlib stream uses stored (uncompressed) deflate
+             blocks, so no zlib is needed and writing costs about as much as
+             a memcpy; the file is roughly the size of the ppm.
+        pfm: portable float map, raw 32 bit linear radiance for HDR use.
+
+    Rows are handed over top to bottom with write_rows, either all at once
+    or a band at a time. Each call encodes its rows into one buffer and
+    issues a single write to the stream. Only the rows of the current call
+    are held, so a band at a time keeps memory bounded for huge images; a
+    pfm written in bands needs a seekable stream (a file, not a pipe).
+*/
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class image_format { ppm, png, pfm };
+
+inline image_format image_format_for(const std::string& path) {
+    // pick the format from the file extension, ppm when it isn't one we know.
+    auto ends_with = [&](const char* ext) {
+        auto n = std::strlen(ext);
+        return path.size() >= n && path.compare(path.size() - n, n, ext) == 0;
+    };
+    if (ends_with(".png")) return image_format::png;
+    if (ends_with(".pfm")) return image_format::pfm;
+    return image_format::ppm;
+}
+
+namespace png_detail {
+
+    constexpr std::array<std::array<std::uint32_t, 256>, 8> make_crc_tables() {
+        // slicing by 8: tables[k][n] is the crc of byte n followed by k zero bytes.
+        std::array<std::array<std::uint32_t, 256>, 8> tables{};
+        for (std::uint32_t n = 0; n < 256; n++) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            tables[0][n] = c;
+        }
+        for (int k = 1; k < 8; k++)
+            for (std::uint32_t n = 0; n < 256; n++)
+                tables[k][n] = (tables[k-1][n] >> 8) ^ tables[0][tables[k-1][n] & 0xff];
+        return tables;
+    }
+
+    inline constexpr auto crc_tables = make_crc_tables();
+
+    inline std::uint32_t crc32(const unsigned char* data, size_t n) {
+        const auto& t = crc_tables;
+        std::uint32_t c = 0xffffffffu;
+        for (; n >= 8; n -= 8, data += 8) {
+            // eight bytes per step, assembled little endian.
+            std::uint32_t lo = c ^ (std::uint32_t(data[0]) | std::uint32_t(data[1]) << 8
+                                  | std::uint32_t(data[2]) << 16 | std::uint32_t(data[3]) << 24);
+            c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+              ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        }
+        for (; n > 0; n--, data++) c = t[0][(c ^ *data) & 0xff] ^ (c >> 8);
+        return c ^ 0xffffffffu;
+    }
+
+    inline void adler32(std::uint32_t& a, std::uint32_t& b, const unsigned char* data, size_t n) {
+        // running adler32 sums. 5552 bytes is the most that can be added before taking the modulo.
+        while (n > 0) {
+            size_t chunk = n < 5552 ? n : 5552;
+            for (size_t i = 0; i < chunk; i++) {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += chunk;
+            n -= chunk;
+        }
+    }
+
+    inline void put_u32be(std::vector<unsigned char>& out, std::uint32_t v) {
+        out.push_back((unsigned char)(v >> 24));
+        out.push_back((unsigned char)(v >> 16));
+        out.push_back((unsigned char)(v >> 8));
+        out.push_back((unsigned char)(v));
+    }
+
+    inline void begin_chunk(std::vector<unsigned char>& out, const char* type) {
+        // the length is filled in by end_chunk.
+        put_u32be(out, 0);
+        out.insert(out.end(), type, type + 4);
+    }
+
+    inline void end_chunk(std::vector<unsigned char>& out, size_t chunk_start) {
+        // chunk_start is out.size() before begin_chunk.
+        size_t data_size = out.size() - chunk_start - 8;
+        for (int k = 0; k < 4; k++) out[chunk_start + k] = (unsigned char)(data_size >> (24 - 8*k));
+        put_u32be(out, crc32(&out[chunk_start + 4], data_size + 4));
+    }
+}
+
+class image_writer {
+    public:
+        image_writer(std::ostream& out_, image_format format_, int width_, int height_)
+            : out(out_), format(format_), width(width_), height(height_), start(out_.tellp()) {
+            write_header();
+            header_bytes = pending.size();
+        }
+
+        void write_rows(const float* linear_rgb, int rows) {
+            // rows are the next rows of the image, top to bottom, 3 floats per pixel.
+            buffer.assign(pending.begin(), pending.end()); // the header, on the first call.
+            size_t header_size = pending.size();
+            pending.clear();
+
+            if (format == image_format::ppm) encode_ppm(linear_rgb, rows);
+            else if (format == image_format::png) encode_png(linear_rgb, rows);
+            else encode_pfm(linear_rgb, rows);
+
+            if (format == image_format::pfm && rows < height) {
+                // pfm stores rows bottom to top, so a band is written at its place counted from
+                // the end of the file. the stream has to be seekable for this.
+                auto data = reinterpret_cast<const char*>(buffer.data());
+                size_t band_bytes = buffer.size() - header_size;
+                size_t rows_below = size_t(height - rows_written - rows);
+                out.write(data, std::streamsize(header_size));
+                out.seekp(start + std::streamoff(header_bytes + rows_below * row_components() * sizeof(float)));
+                out.write(data + header_size, std::streamsize(band_bytes));
+                rows_written += rows;
+                return;
+            }
+
+            rows_written += rows;
+            if (format == image_format::png && rows_written == height) {
+                size_t iend = buffer.size();
+                png_detail::begin_chunk(buffer, "IEND");
+                png_detail::end_chunk(buffer, iend);
+            }
+
+            out.write(reinterpret_cast<const char*>(buffer.data()), std::streamsize(buffer.size()));
+        }
+
+        void finish() {
+            out.flush();
+        }
+
+    private:
+        std::ostream& out;
+        image_format format;
+        int width, height;
+        int rows_written = 0;
+        std::streampos start; // where the image starts in the stream.
+        size_t header_bytes = 0;
+
+        std::vector<unsigned char> buffer;
+        std::vector<unsigned char> pending; // header bytes, sent along with the first rows.
+        std::vector<unsigned char> raw; // png: filtered scanlines, before they are split into blocks.
+        std::uint32_t adler_a = 1, adler_b = 0; // png: adler32 of the whole zlib stream.
+
+        size_t row_components() const { return size_t(width) * 3; }
+
+        void write_header() {
+            if (format == image_format::png) {
+                static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+                pending.insert(pending.end(), signature, signature + 8);
+
+                png_detail::begin_chunk(pending, "IHDR");
+                png_detail::put_u32be(pending, std::uint32_t(width));
+                png_detail::put_u32be(pending, std::uint32_t(height));
+                // 8 bits per channel, rgb, deflate, no filtering method, no interlace.
+                const unsigned char ihdr[5] = {8, 2, 0, 0, 0};
+                pending.insert(pending.end(), ihdr, ihdr + 5);
+                png_detail::end_chunk(pending, 8);
+                return;
+            }
+
+            std::string header;
+            if (format == image_format::ppm)
+                header = "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+            else // a negative scale marks little endian floats.
+                header = "PF\n" + std::to_string(width) + ' ' + std::to_string(height) + '\n'
+                       + (std::endian::native == std::endian::little ? "-1.0\n" : "1.0\n");
+            pending.assign(header.begin(), header.end());
+        }
+
+        void encode_ppm(const float* linear_rgb, int rows) {
+            size_t start = buffer.size();
+            size_t n = row_components() * rows;
+            buffer.resize(start + n);
+            linear_to_bytes(linear_rgb, &buffer[start], n);
+        }
+
+        void encode_png(const float* linear_rgb, int rows) {
+            // scanlines: a filter type byte (0, none) followed by the row bytes.
+            raw.resize(size_t(rows) * (row_components() + 1));
+            for (int r = 0; r < rows; r++) {
+                unsigned char* line = &raw[size_t(r) * (row_components() + 1)];
+                line[0] = 0;
+                linear_to_bytes(linear_rgb + size_t(r) * row_components(), line + 1, row_components());
+            }
+            png_detail::adler32(adler_a, adler_b, raw.data(), raw.size());
+
+            // one IDAT chunk per call, the zlib stream continues from one chunk into the next.
+            bool first = rows_written == 0;
+            bool last = rows_written + rows == height;
+            buffer.reserve(buffer.size() + raw.size() + (raw.size() / 65535 + 1) * 5 + 64);
+            size_t chunk = buffer.size();
+            png_detail::begin_chunk(buffer, "IDAT");
+            if (first) {
+                buffer.push_back(0x78); // deflate, 32K window.
+                buffer.push_back(0x01); // no dictionary, fastest level; 0x7801 is a multiple of 31.
+            }
+
+            // stored blocks hold at most 65535 bytes each.
+            size_t offset = 0;
+            do {
+                size_t len = std::min<size_t>(raw.size() - offset, 65535);
+                bool final_block = last && offset + len == raw.size();
+                buffer.push_back(final_block ? 1 : 0);
+                buffer.push_back((unsigned char)(len));
+                buffer.push_back((unsigned char)(len >> 8));
+                buffer.push_back((unsigned char)(~len));
+                buffer.push_back((unsigned char)(~len >> 8));
+                buffer.insert(buffer.end(), raw.begin() + offset, raw.begin() + offset + len);
+                offset += len;
+            } while (offset < raw.size());
+
+            if (last) png_detail::put_u32be(buffer, (adler_b << 16) | adler_a);
+            png_detail::end_chunk(buffer, chunk);
+        }
+
+        void encode_pfm(const float* linear_rgb, int rows) {
+            // pfm stores rows bottom to top.
+            size_t start = buffer.size();
+            size_t row_bytes = row_components() * sizeof(float);
+            buffer.resize(start + row_bytes * rows);
+            for (int r = 0; r < rows; r++)
+                std::memcpy(&buffer[start + size_t(rows - 1 - r) * row_bytes],
+                            linear_rgb + size_t(r) * row_components(), row_bytes);
+        }
+};
+
+inline void write_image(std::ostream& out, image_format format, const framebuffer& image) {
+    image_writer writer(out, format, image.width, image.height);
+    writer.write_rows(image.row(0), image.height);
+    writer.finish();
+}
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+/*
+    Instancing: one piece of geometry placed many times, each time with its
+    own affine transform and optionally its own material.
+
+    An instance doesn't copy or move its geometry. The ray is taken into
+    the geometry's object space instead (origin and direction through the
+    inverse transform, once per instance the ray visits), the geometry is
+    hit there, and the hit is brought back: the point is evaluated on the
+    world ray and the normal goes through the inverse transpose. The
+    direction isn't renormalized, so t is the same in both spaces and the
+    interval of the world ray can be passed down as it is.
+
+    instance_tree is the two-level structure for many instances: a bottom
+    level per unique geometry (whatever acceleration structure it has of
+    its own: a bvh_node over a cluster of spheres, a mesh, a closed_scene)
+    and a top level bvh over the world boxes of the instances. An instance
+    is only its inverse transform, a material, a geometry index and its
+    world box, so a million copies of a big object cost a million small
+    records and one copy of the object. instance_bvh makes an instance_tree
+    a hittable, instance is a single instance as a hittable.
+*/
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+class affine_transform {
+    // p -> m p + t, as the 3x4 matrix [m | t].
+    public:
+        real m[3][4];
+
+        affine_transform() : m{{1,0,0,0}, {0,1,0,0}, {0,0,1,0}} {}
+
+        static affine_transform translate(const vec3& offset) {
+            affine_transform a;
+            for (int i = 0; i < 3; i++) a.m[i][3] = offset[i];
+            return a;
+        }
+
+        static affine_transform scale(const vec3& factors) {
+            affine_transform a;
+            for (int i = 0; i < 3; i++) a.m[i][i] = factors[i];
+            return a;
+        }
+
+        static affine_transform rotate(const vec3& axis, real degrees) {
+            // counterclockwise looking down the axis towards the origin.
+            vec3 u = unit_vector(axis);
+            real c = std::cos(degrees_to_radians(degrees)), s = std::sin(degrees_to_radians(degrees));
+            affine_transform a;
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 3; j++) a.m[i][j] = (1 - c)*u[i]*u[j] + (i == j ? c : 0);
+            a.m[0][1] -= s*u[2]; a.m[0][2] += s*u[1];
+            a.m[1][0] += s*u[2]; a.m[1][2] -= s*u[0];
+            a.m[2][0] -= s*u[1]; a.m[2][1] += s*u[0];
+            return a;
+        }
+
+        friend affine_transform operator*(const affine_transform& a, const affine_transform& b) {
+            // b, then a.
+            affine_transform r;
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 4; j++) {
+                    r.m[i][j] = a.m[i][0]*b.m[0][j] + a.m[i][1]*b.m[1][j] + a.m[i][2]*b.m[2][j];
+                    if (j == 3) r.m[i][j] += a.m[i][3];
+                }
+            return r;
+        }
+
+        bool operator==(const affine_transform& other) const {
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 4; j++)
+                    if (m[i][j] != other.m[i][j]) return false;
+            return true;
+        }
+
+        point3 point(const point3& p) const { return vector(p) + vec3(m[0][3], m[1][3], m[2][3]); }
+
+        vec3 vector(const vec3& v) const {
+            return vec3(m[0][0]*v[0] + m[0][1]*v[1] + m[0][2]*v[2],
+                        m[1][0]*v[0] + m[1][1]*v[1] + m[1][2]*v[2],
+                        m[2][0]*v[0] + m[2][1]*v[1] + m[2][2]*v[2]);
+        }
+
+        vec3 transposed_vector(const vec3& v) const {
+            // the transpose of the linear part times v. normals go through the inverse's transpose.
+            return vec3(m[0][0]*v[0] + m[1][0]*v[1] + m[2][0]*v[2],
+                        m[0][1]*v[0] + m[1][1]*v[1] + m[2][1]*v[2],
+                        m[0][2]*v[0] + m[1][2]*v[1] + m[2][2]*v[2]);
+        }
+
+        real determinant() const {
+            return m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+                 - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+                 + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+        }
+
+        bool invertible() const {
+            real d = determinant();
+            return d != 0 && std::isfinite(d);
+        }
+
+        affine_transform inverse() const {
+            // only meaningful if invertible().
+            real inv_det = real(1) / determinant();
+            affine_transform r;
+            for (int i = 0; i < 3; i++)
+                for (int j = 0; j < 3; j++) {
+                    // cofactor of m[j][i].
+                    int j1 = (j + 1) % 3, j2 = (j + 2) % 3, i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+                    r.m[i][j] = (m[j1][i1]*m[j2][i2] - m[j1][i2]*m[j2][i1]) * inv_det;
+                }
+            vec3 t = r.vector(vec3(m[0][3], m[1][3], m[2][3]));
+            for (int i = 0; i < 3; i++) r.m[i][3] = -t[i];
+            return r;
+        }
+
+        aabb box(const aabb& b) const {
+            // encloses the transformed corners of b.
+            if (b.x.size() < 0 || b.y.size() < 0 || b.z.size() < 0) return aabb();
+            aabb result;
+            for (int corner = 0; corner < 8; corner++) {
+                point3 p = point(point3(corner & 1 ? b.x.max : b.x.min,
+                                        corner & 2 ? b.y.max : b.y.min,
+                                        corner & 4 ? b.z.max : b.z.min));
+                result = aabb(result, aabb(p, p));
+            }
+            return result;
+        }
+};
+
+template <typename Geometry>
+inline bool hit_instance(const Geometry& geometry, const affine_transform& to_object, const material* mat,
+        const ray& r, interval ray_t, hit_record& rec) {
+    // geometry hit in object space. mat replaces the geometry's material unless it is null.
+    ray local(to_object.point(r.origin()), to_object.vector(r.direction()), r.time());
+    if (!geometry.hit(local, ray_t, rec)) return false;
+    rec.p = r.at(rec.t);
+    rec.normal = unit_vector(to_object.transposed_vector(rec.normal));
+    if (mat) rec.mat = mat;
+    return true;
+}
+
+template <typename Geometry>
+class instance_tree {
+    // Geometry needs hit(ray, interval, hit_record&) and bounding_box().
+    public:
+        std::uint32_t add_geometry(shared_ptr<const Geometry> geometry) {
+            owned.push_back(geometry);
+            return add_geometry(geometry.get());
+        }
+
+        std::uint32_t add_geometry(const Geometry* geometry) {
+            // geometry that something else keeps alive, like the scene_arena it was created in.
+            geometries.push_back(geometry);
+            return std::uint32_t(geometries.size() - 1);
+        }
+
+        void add(std::uint32_t geometry, const affine_transform& to_world, const material* mat = nullptr) {
+            // to_world has to be invertible. a null mat keeps the geometry's materials. an
+            // instance of empty geometry can't be hit and is left out.
+            aabb box = to_world.box(geometries[geometry]->bounding_box());
+            if (box.x.size() < 0) return;
+            instances.push_back({to_world.inverse(), mat, geometry});
+            boxes.push_back(box);
+            tree.nodes.clear(); // the bvh no longer covers every instance.
+        }
+
+        void build() {
+            // the top level bvh, instances in leaf order.
+            tree.build(boxes);
+            std::vector<instance_record> ordered;
+            std::vector<aabb> ordered_boxes;
+            ordered.reserve(instances.size());
+            ordered_boxes.reserve(boxes.size());
+            for (auto index : tree.indices) {
+                ordered.push_back(instances[index]);
+                ordered_boxes.push_back(boxes[index]);
+            }
+            instances.swap(ordered);
+            boxes.swap(ordered_boxes);
+            std::iota(tree.indices.begin(), tree.indices.end(), 0);
+            bbox = tree.bounds();
+        }
+
+        size_t size() const { return instances.size(); }
+        size_t geometry_count() const { return geometries.size(); }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+            return tree.hit(r, ray_t, [&](std::uint32_t i, interval& t) {
+                const instance_record& inst = instances[i];
+                if (!hit_instance(*geometries[inst.geometry], inst.to_object, inst.mat, r, t, rec)) return false;
+                t.max = rec.t;
+                return true;
+            });
+        }
+
+        aabb bounding_box() const { return bbox; }
+
+    private:
+        struct instance_record {
+            affine_transform to_object; // all the hit needs, the forward transform isn't kept.
+            const material* mat;
+            std::uint32_t geometry;
+        };
+
+        std::vector<const Geometry*> geometries;
+        std::vector<shared_ptr<const Geometry>> owned; // the geometries added by shared_ptr.
+        std::vector<instance_record> instances;
+        std::vector<aabb> boxes; // world boxes of the instances, for the top level bvh.
+        bvh_tree tree;
+        aabb bbox;
+};
+
+class instance_bvh : public hittable {
+    public:
+        explicit instance_bvh(instance_tree<hittable> instances_) : instances(std::move(instances_)) {
+            instances.build();
+        }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return instances.hit(r, ray_t, rec);
+        }
+
+        aabb bounding_box() const override { return instances.bounding_box(); }
+
+    private:
+        instance_tree<hittable> instances;
+};
+
+class instance : public hittable {
+    public:
+        instance(shared_ptr<const hittable> geometry_, const affine_transform& to_world, const material* mat_ = nullptr)
+            : geometry(geometry_), to_object(to_world.inverse()), mat(mat_),
+              bbox(to_world.box(geometry->bounding_box())) {}
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return hit_instance(*geometry, to_object, mat, r, ray_t, rec);
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+    private:
+        shared_ptr<const hittable> geometry;
+        affine_transform to_object;
+        const material* mat;
+        aabb bbox;
+};
+
+#endif
@@ -1,29 +1,46 @@
 #ifndef INTERVAL_H
 #define INTERVAL_H
 
-class interval {
+template <typename T>
+class interval_t {
     public:
-        double min, max;
-        interval() : min{+infinity}, max{-infinity} {} // why these values
+        T min, max;
+        interval_t() : min{T(+infinity)}, max{T(-infinity)} {} // why these values
 
-        interval(double min_, double max_) : min{min_}, max{max_} {}
+        interval_t(T min_, T max_) : min{min_}, max{max_} {}
 
-        double size() const { return max - min;}
+        interval_t(const interval_t& a, const interval_t& b) {
+            // create the interval tightly enclosing the two input intervals.
+            min = a.min <= b.min ? a.min : b.min;
+            max = a.max >= b.max ? a.max : b.max;
+        }
+
+        T size() const { return max - min;}
 
-        bool contains(double x) const { return min <= x && x <= max;}
+        bool contains(T x) const { return min <= x && x <= max;}
 
-        bool surrounds(double x) const {return min < x && x < max; }
+        bool surrounds(T x) const {return min < x && x < max; }
 
-        double clamp(double x) const {
+        T clamp(T x) const {
             if (x < min) return min;
             if (x > max) return max;
             return x;
         }
 
-        static const interval empty, universe;
+        interval_t expand(T delta) const {
+            // pad the interval by delta/2 on both sides.
+            auto padding = delta/2;
+            return interval_t(min - padding, max + padding);
+        }
+
+        static const interval_t empty, universe;
 };
 
-const interval interval::empty = interval(+infinity, -infinity);
-const interval interval::universe = interval (-infinity, infinity);
+template <typename T>
+const interval_t<T> interval_t<T>::empty = interval_t<T>(T(+infinity), T(-infinity));
+template <typename T>
+const interval_t<T> interval_t<T>::universe = interval_t<T>(T(-infinity), T(infinity));
+
+using interval = interval_t<real>;
 
-#endif
\ No newline at end of file
+#endif
@@ -1,10 +1,17 @@
 #include "rtweekend.h"
+#include "bvh.h"
 #include "camera.h"
+#include "closed_scene.h"
 #include "hittable.h"
 #include "hittable_list.h"
 #include "material.h"
+#include "scene_binary.h"
+#include "scene_file.h"
+#include "scenes.h"
 #include "sphere.h"
 #include <algorithm>
+#include <string>
+#include <type_traits>
 
 
 
@@ -55,89 +62,158 @@
 
 
 
-int main(){
-
-    // world
-    hittable_list world;
-
-
-    auto ground_material = make_shared<lambertian>(color(0.5, 0.5, 0.5));
-    world.add(make_shared<sphere>(point3(0,-1000, 0), 1000, ground_material));
-
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++){
-            auto choose_mat = random_double();
-            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
-
-            if ((center- point3(4,0.2, 0)).length() > 0.9) {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8) {
-                    // diffuse
-                    auto albedo = color::random() * color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = color::random(0.5,1);
-                    auto fuzz = random_double(0,0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else {
-                    // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<sphere>(center, 0.2, sphere_material));
-                }
+int main(int argc, char* argv[]){
+
+    // --closed renders through closed_scene (variant/switch dispatch) instead of the
+    // virtual hittable/material path, --batch tests all the spheres at once with SIMD (see
+    // sphere_batch.h) instead of walking a bvh. -o writes the image to a file, the format
+    // follows the extension (.ppm, .png, .pfm); without it a ppm goes to stdout. --stream writes
+    // the image band by band as it renders instead of holding the whole frame.
+    // --pass N renders progressively in passes of N samples per pixel, --checkpoint FILE
+    // saves (and resumes) the progress there, and --spp N sets the samples per pixel.
+    // --overwrite-checkpoint starts over when that file is from another render.
+    // --adaptive stops sampling pixels once their noise is below --noise X (default
+    // 0.004), --time S stops a progressive or adaptive render after S seconds.
+    // --sampler NAME picks independent (default), sobol, halton or zsobol samples.
+    // --denoise filters the finished frame, which makes low sample counts usable.
+    // --scene NAME picks a preset from scenes.h (random, material_test, dense, instanced),
+    // --scene-file FILE loads a text or binary scene file (see scene_file.h, scene_binary.h)
+    // instead.
+    // --save-scene FILE writes the scene and camera out as a text scene file and exits
+    // without rendering. --huge-pages backs the scene's arena with (transparent) huge pages;
+    // --closed and binary scenes don't build one, so it can't go with them.
+    // --stats FILE saves the render statistics of an RT_STATS build as JSON.
+    // --trace FILE saves a timeline of the render for chrome://tracing or ui.perfetto.dev.
+    bool closed = false;
+    bool batch = false;
+    scene_id scene = scene_id::random;
+    bool stream = false;
+    int samples_per_pixel = 0; // 0 keeps the scene file's, or 500.
+    int samples_per_pass = 0;
+    std::string checkpoint_path;
+    bool overwrite_checkpoint = false;
+    bool adaptive = false;
+    double noise_target = 0.004;
+    double time_budget = 0;
+    sampler_type sampler = sampler_type::independent;
+    bool denoise = false;
+    bool huge_pages = false;
+    std::string stats_path;
+    std::string trace_path;
+    std::string scene_path;
+    std::string save_scene_path;
+    std::string output_path;
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--closed") closed = true;
+        else if (arg == "--batch") batch = true;
+        else if (arg == "--stream") stream = true;
+        else if (arg == "--spp" && k + 1 < argc) samples_per_pixel = std::atoi(argv[++k]);
+        else if (arg == "--pass" && k + 1 < argc) samples_per_pass = std::atoi(argv[++k]);
+        else if (arg == "--checkpoint" && k + 1 < argc) checkpoint_path = argv[++k];
+        else if (arg == "--overwrite-checkpoint") overwrite_checkpoint = true;
+        else if (arg == "--adaptive") adaptive = true;
+        else if (arg == "--noise" && k + 1 < argc) noise_target = std::atof(argv[++k]);
+        else if (arg == "--time" && k + 1 < argc) time_budget = std::atof(argv[++k]);
+        else if (arg == "--denoise") denoise = true;
+        else if (arg == "--huge-pages") huge_pages = true;
+        else if (arg == "--stats" && k + 1 < argc) stats_path = argv[++k];
+        else if (arg == "--trace" && k + 1 < argc) trace_path = argv[++k];
+        else if (arg == "--sampler" && k + 1 < argc) {
+            if (!sampler_type_for(argv[++k], sampler)) {
+                std::clog << "Unknown sampler " << argv[k] << ".\n";
+                return 1;
+            }
+        }
+        else if (arg == "--scene" && k + 1 < argc) {
+            if (!scene_id_for(argv[++k], scene)) {
+                std::clog << "Unknown scene " << argv[k] << ".\n";
+                return 1;
             }
         }
+        else if (arg == "--scene-file" && k + 1 < argc) scene_path = argv[++k];
+        else if (arg == "--save-scene" && k + 1 < argc) save_scene_path = argv[++k];
+        else if (arg == "-o" && k + 1 < argc) output_path = argv[++k];
+    }
+    if (huge_pages && closed) {
+        std::clog << "--huge-pages is for the arena of the hittable world, --closed doesn't use one.\n";
+        return 1;
     }
-
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<sphere>(point3(0,1,0), 1.0, material1));
-
-    auto material2 = make_shared<lambertian>(color(.04, 0.2, 0.1));
-    world.add(make_shared<sphere>(point3(-4, 1,0), 1.0, material2));
-
-    auto material3 = make_shared<metal>(color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<sphere>(point3(4,1,0), 1.0, material3));
-
-
-    // auto R = std::cos(pi/4);
-
-    // // auto material_left = make_shared<lambertian>(color(0,0,1));
-    // // auto material_right = make_shared<lambertian>(color(1,0,0));
-
-    // // world.add(make_shared<sphere>(point3(-R, 0,-1), R, material_left));
-    // // world.add(make_shared<sphere>(point3( R, 0,-1), R, material_right));
-
-    // auto material_ground = make_shared<lambertian>(color(0.8, 0.8,0.0));
-    // auto material_center = make_shared<lambertian>(color(0.1,0.2,0.5));
-    // auto material_left = make_shared<dielectric>(1.5);
-    // auto material_bubble = make_shared<dielectric>(1.0/1.5);
-    // auto material_right = make_shared<metal>(color(0.8,0.6,0.2), 1.0);
-
-    // world.add(make_shared<sphere>(point3(0,-100.5,-1.0), 100.0, material_ground));
-    // world.add(make_shared<sphere>(point3(0, 0.0, -1.2), 0.5, material_center));
-    // world.add(make_shared<sphere>(point3(-1.0,0.0,-1.0), 0.5, material_left));
-    // world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.4, material_bubble));
-    // world.add(make_shared<sphere>(point3(1.0, 0.0, -1.0), 0.5, material_right));
 
     camera cam;
-
-    cam.aspect_ratio = 16.0/9.0;
+    cam.output_path = output_path;
+    cam.output_format = image_format_for(output_path);
+    cam.stream_output = stream;
+    cam.samples_per_pass = samples_per_pass;
+    cam.checkpoint_path = checkpoint_path;
+    cam.overwrite_checkpoint = overwrite_checkpoint;
+    cam.adaptive_sampling = adaptive;
+    cam.noise_target = noise_target;
+    cam.time_budget = time_budget;
+    cam.sampler = sampler;
+    cam.denoise = denoise;
+    cam.stats_path = stats_path;
+    cam.trace_path = trace_path;
+
+    set_scene_view(scene, cam);
     cam.image_width = 1200;
     cam.samples_per_pixel = 500;
     cam.max_depth = 50;
 
-    cam.vfov = 20;
-    cam.lookfrom = point3(13,2,3);
-    cam.lookat = point3(0,0,0);
-    cam.vup = vec3(0,1,0);
+    if (!scene_path.empty() && is_binary_scene(scene_path)) {
+        // rendered straight from the mapped file, see scene_binary.h.
+        mapped_scene world;
+        std::string error;
+        if (!world.open(scene_path, cam, error)) {
+            std::clog << "Can't load scene: " << error << ".\n";
+            return 1;
+        }
+        if (samples_per_pixel > 0) cam.samples_per_pixel = samples_per_pixel;
+        if (!save_scene_path.empty()) {
+            std::clog << "Binary scenes can't be saved as text.\n";
+            return 1;
+        }
+        if (huge_pages) {
+            std::clog << "--huge-pages is for the arena of the hittable world, binary scenes are mapped from their file.\n";
+            return 1;
+        }
+        if (!checkpoint_path.empty()) cam.scene_hash = world.hash();
+        cam.render(world);
+        return 0;
+    }
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
+    scene_description description;
+    if (scene_path.empty()) {
+        description = preset_scene(scene);
+    }
+    else {
+        std::string error;
+        if (!load_scene(scene_path, description, cam, error)) {
+            std::clog << "Can't load scene: " << error << ".\n";
+            return 1;
+        }
+    }
+    if (samples_per_pixel > 0) cam.samples_per_pixel = samples_per_pixel;
 
-    cam.render(world);
-}
\ No newline at end of file
+    if (!save_scene_path.empty()) {
+        if (!save_scene(save_scene_path, description, cam)) {
+            std::clog << "Can't write " << save_scene_path << ".\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (!checkpoint_path.empty()) cam.scene_hash = description.hash();
+
+    if (closed) {
+        closed_scene world;
+        build_world(description, world);
+        cam.render(world);
+    }
+    else {
+        hittable_list world;
+        material_table materials; // owns the materials, spheres only point at them.
+        if (batch) build_batch_world(description, world, materials, scene_arena(huge_pages));
+        else build_world(description, world, materials, scene_arena(huge_pages));
+        cam.render(world);
+    }
+}
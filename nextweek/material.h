@@ -4,8 +4,17 @@
 #include "rtweekend.h"
 #include "hittable.h"
 
+#include <cstdint>
+#include <vector>
+
+// tag for the built in materials, so closed-set code can switch on the type instead of a virtual call.
+enum class material_kind : std::uint8_t { other, lambertian, metal, dielectric };
+
 class material {
     public:
+        const material_kind kind;
+
+        material(material_kind kind_ = material_kind::other) : kind(kind_) {}
         virtual ~material() = default;
 
         virtual bool scatter(const ray& r_in, const hit_record& rec,
@@ -15,12 +24,12 @@ class material {
 };
 
 
-class lambertian : public material {
+class lambertian final : public material {
     private:
         color albedo;
 
     public:
-        lambertian(const color& albedo) : albedo(albedo){}
+        lambertian(const color& albedo) : material(material_kind::lambertian), albedo(albedo){}
 
         bool scatter(const ray& r_in, const hit_record& rec, 
                 color& attenuation, ray& scattered) const override {
@@ -30,14 +39,15 @@ class lambertian : public material {
 
             scattered = ray(rec.p, scatter_direction);
             attenuation = albedo;
+            RT_STAT_COUNT(lambertian_scatters);
             return true;
         }
 };
 
-class metal : public material {
+class metal final : public material {
     private:
         color albedo;
-        double fuzz; // fuzz reflection factor, 
+        real fuzz; // fuzz reflection factor, 
         /* this fuzz factor is used to generate a small sphere centered on the 
          * original endpoint of the reflected ray, scaled by fuzz factor.  
          * For the bigger fuzz sphere, the rays might scatter below the surface.
@@ -45,7 +55,7 @@ class metal : public material {
         */
 
     public:
-        metal(const color& albedo, double fuzz_) : albedo(albedo), fuzz(std::fmin(1,fuzz_)) {}
+        metal(const color& albedo, real fuzz_) : material(material_kind::metal), albedo(albedo), fuzz(std::fmin(1,fuzz_)) {}
 
         bool scatter(const ray& r_in, const hit_record& rec, 
                 color& attenuation, ray& scattered) const override {
@@ -53,14 +63,17 @@ class metal : public material {
             reflected = unit_vector(reflected) + (fuzz * random_unit_vector());
             scattered = ray(rec.p, reflected);
             attenuation = albedo;
-            return (dot(scattered.direction(), rec.normal) > 0);
+            bool above = dot(scattered.direction(), rec.normal) > 0;
+            if (above) RT_STAT_COUNT(metal_reflections);
+            else RT_STAT_COUNT(metal_absorptions);
+            return above;
         }
 };
 
 
-class dielectric: public material {
+class dielectric final : public material {
     private:
-        double refraction_index;
+        real refraction_index;
 
         static double reflectance(double cosine, double ri) {
             // use schlick's approximation for reflectance.
@@ -71,13 +84,13 @@ class dielectric: public material {
 
     
     public:
-        dielectric(double refraction_index_) : refraction_index(refraction_index_) {}
+        dielectric(real refraction_index_) : material(material_kind::dielectric), refraction_index(refraction_index_) {}
 
         bool scatter(const ray& r_in, const hit_record& rec,
                 color& attenuation, ray& scattered) const override {
             
             attenuation = color(1.0,1.0,1.0); // does it mean how much light is reflected?
-            double ri = rec.front_face ? (1.0/refraction_index) : refraction_index;
+            real ri = rec.front_face ? (1.0/refraction_index) : refraction_index;
             
             vec3 unit_direction = unit_vector(r_in.direction());
             // total internal reflection. 
@@ -88,18 +101,62 @@ class dielectric: public material {
                     if (ray * sin_theta > 1.0) // ray doesn't have valid solution, must reflect.  
                     else // ray have valid solution, ray can refract.
             */
-            double cos_theta = std::fmin(dot(-unit_direction, rec.normal), 1.0);
-            double sin_theta = std::sqrt(1.0 - cos_theta*cos_theta);
+            real cos_theta = std::fmin(dot(-unit_direction, rec.normal), real(1.0));
+            real sin_theta = std::sqrt(real(1.0) - cos_theta*cos_theta);
 
             bool cannot_refract = ri * sin_theta > 1.0;
             vec3 direction;
 
-            if (cannot_refract || (reflectance(cos_theta, ri)>  ri)) direction = reflect(unit_direction, rec.normal);
-            else direction = refract(unit_direction, rec.normal, ri);
+            if (cannot_refract || (reflectance(cos_theta, ri)>  ri)) {
+                direction = reflect(unit_direction, rec.normal);
+                RT_STAT_COUNT(dielectric_reflections);
+            } else {
+                direction = refract(unit_direction, rec.normal, ri);
+                RT_STAT_COUNT(dielectric_refractions);
+            }
             // vec3 refracted = refract(unit_direction, rec.normal, ri);
             scattered = ray(rec.p, direction);
             return true;
         }
 };
 
+
+inline bool scatter_closed(const material& mat, const ray& r_in, const hit_record& rec,
+        color& attenuation, ray& scattered) {
+    // switch over the built in materials and call them directly, so the scatter code can be
+    // inlined into the integrator. any other material still goes through the vtable.
+    switch (mat.kind) {
+        case material_kind::lambertian:
+            return static_cast<const lambertian&>(mat).lambertian::scatter(r_in, rec, attenuation, scattered);
+        case material_kind::metal:
+            return static_cast<const metal&>(mat).metal::scatter(r_in, rec, attenuation, scattered);
+        case material_kind::dielectric:
+            return static_cast<const dielectric&>(mat).dielectric::scatter(r_in, rec, attenuation, scattered);
+        default:
+            return mat.scatter(r_in, rec, attenuation, scattered);
+    }
+}
+
+class material_table {
+    /*
+        owns every material of a scene. primitives and hit records only hold the
+        plain pointers handed out by add(), so the hit path never touches a
+        reference count. the table must outlive everything rendered with it.
+    */
+    private:
+        std::vector<shared_ptr<material>> owned;
+
+    public:
+        const material* add(shared_ptr<material> mat) {
+            owned.push_back(mat);
+            return owned.back().get();
+        }
+
+        const material* operator[](size_t i) const { return owned[i].get(); }
+
+        size_t size() const { return owned.size(); }
+
+        void clear() { owned.clear(); }
+};
+
 #endif
\ No newline at end of file
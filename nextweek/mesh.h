@@ -0,0 +1,220 @@
+#ifndef MESH_H
+#define MESH_H
+
+/*
+    Triangle meshes.
+
+    triangle_mesh is the shared geometry: one array of vertex positions,
+    optionally one of vertex normals, and three indices into them per
+    triangle, so a mesh is a few flat arrays however many triangles it has,
+    rather than an object per triangle. build() puts a bvh over its
+    triangles (stored in leaf order), so a mesh is a single primitive to
+    the scene's own acceleration structure: mesh_shape goes into a
+    closed_scene by value like sphere_shape, and mesh is the hittable for
+    hittable_list and bvh_node.
+
+    Rays are tested against triangles with the watertight algorithm of
+    Woop, Benthin and Wald (JCGT 2013): the ray is sheared so it runs along
+    +z from the origin, the triangle is projected into that frame and the
+    hit decided by the signs of three 2D edge functions. A ray can't slip
+    through the shared edge or vertex of two triangles, and the edge
+    functions are recomputed in double when a float build gets exactly
+    zero. The shear is set up once per ray for all the triangles it meets.
+*/
+
+#include "rtweekend.h"
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+class watertight_ray {
+    // a ray in the sheared frame of the watertight test.
+    public:
+        point3 origin;
+        int kx, ky, kz; // kz is the dimension the direction is largest in.
+        real sx, sy, sz;
+
+        explicit watertight_ray(const ray& r) : origin(r.origin()) {
+            const vec3& d = r.direction();
+            kz = max_dimension(d);
+            kx = kz == 2 ? 0 : kz + 1;
+            ky = kx == 2 ? 0 : kx + 1;
+            if (d[kz] < 0) std::swap(kx, ky); // keeps the winding of the triangles.
+            sx = d[kx] / d[kz];
+            sy = d[ky] / d[kz];
+            sz = real(1) / d[kz];
+        }
+
+        /*
+            true if the ray hits triangle p0 p1 p2 strictly inside ray_t. t is the distance
+            along the ray, b the barycentric weights of p0, p1 and p2.
+        */
+        bool hit(const point3& p0, const point3& p1, const point3& p2, const interval& ray_t,
+                real& t, real b[3]) const {
+            vec3 a = p0 - origin, c = p2 - origin, e = p1 - origin;
+            real ax = a[kx] - sx*a[kz], ay = a[ky] - sy*a[kz];
+            real bx = e[kx] - sx*e[kz], by = e[ky] - sy*e[kz];
+            real cx = c[kx] - sx*c[kz], cy = c[ky] - sy*c[kz];
+
+            real u = cx*by - cy*bx;
+            real v = ax*cy - ay*cx;
+            real w = bx*ay - by*ax;
+            if constexpr (std::is_same_v<real, float>) {
+                // an edge function of exactly zero may just be float rounding, decide it in double.
+                if (u == 0 || v == 0 || w == 0) {
+                    u = real(double(cx)*double(by) - double(cy)*double(bx));
+                    v = real(double(ax)*double(cy) - double(ay)*double(cx));
+                    w = real(double(bx)*double(ay) - double(by)*double(ax));
+                }
+            }
+            if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0)) return false;
+
+            real det = u + v + w;
+            if (det == 0) return false; // seen edge on.
+
+            real scaled_t = u*sz*a[kz] + v*sz*e[kz] + w*sz*c[kz];
+            t = scaled_t / det;
+            if (!ray_t.surrounds(t)) return false;
+
+            b[0] = u / det;
+            b[1] = v / det;
+            b[2] = w / det;
+            return true;
+        }
+
+    private:
+        static int max_dimension(const vec3& d) {
+            real x = std::fabs(d.x()), y = std::fabs(d.y()), z = std::fabs(d.z());
+            return x > y ? (x > z ? 0 : 2) : (y > z ? 1 : 2);
+        }
+};
+
+class triangle_mesh {
+    public:
+        static constexpr std::uint32_t no_normal = UINT32_MAX;
+
+        std::vector<point3> positions;
+        std::vector<vec3> normals;
+        std::vector<std::uint32_t> indices; // three per triangle, into positions.
+        // three per triangle into normals, no_normal where a corner has none. empty if no
+        // triangle has normals, the geometric normal is used then.
+        std::vector<std::uint32_t> normal_indices;
+
+        size_t triangle_count() const { return indices.size() / 3; }
+
+        aabb triangle_box(size_t k) const {
+            const point3& p0 = positions[indices[3*k]];
+            const point3& p1 = positions[indices[3*k + 1]];
+            const point3& p2 = positions[indices[3*k + 2]];
+            return aabb(aabb(p0, p1), aabb(p2, p2));
+        }
+
+        void build() {
+            // build the bvh over the triangles and reorder them in leaf order, like closed_scene.
+            std::vector<aabb> boxes(triangle_count());
+            for (size_t k = 0; k < boxes.size(); k++) boxes[k] = triangle_box(k);
+            tree.build(boxes);
+
+            auto reorder = [&](std::vector<std::uint32_t>& per_corner) {
+                if (per_corner.empty()) return;
+                std::vector<std::uint32_t> ordered(per_corner.size());
+                for (size_t k = 0; k < tree.indices.size(); k++)
+                    for (int c = 0; c < 3; c++) ordered[3*k + c] = per_corner[3*size_t(tree.indices[k]) + c];
+                per_corner.swap(ordered);
+            };
+            reorder(indices);
+            reorder(normal_indices);
+            std::iota(tree.indices.begin(), tree.indices.end(), 0);
+            bbox = tree.bounds();
+        }
+
+        aabb bounding_box() const { return bbox; }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec, const material* mat) const {
+            watertight_ray w(r);
+            std::uint32_t closest = 0;
+            real closest_b[3];
+            bool hit_anything = tree.hit(r, ray_t, [&](std::uint32_t k, interval& t_range) {
+                RT_STAT_COUNT(triangle_tests);
+                real t, b[3];
+                if (!w.hit(positions[indices[3*k]], positions[indices[3*k + 1]], positions[indices[3*k + 2]],
+                           t_range, t, b)) return false;
+                t_range.max = t;
+                closest = k;
+                for (int c = 0; c < 3; c++) closest_b[c] = b[c];
+                return true;
+            });
+            if (!hit_anything) return false;
+
+            // fill the record once, for the closest triangle only.
+            const point3& p0 = positions[indices[3*closest]];
+            const point3& p1 = positions[indices[3*closest + 1]];
+            const point3& p2 = positions[indices[3*closest + 2]];
+            vec3 geometric = unit_vector(cross(p1 - p0, p2 - p0));
+
+            rec.t = ray_t.max;
+            rec.p = r.at(rec.t);
+            rec.mat = mat;
+            rec.front_face = dot(r.direction(), geometric) < 0;
+            vec3 n = shading_normal(closest, closest_b);
+            if (n.near_zero()) n = geometric;
+            else if (dot(n, geometric) < 0) n = -n; // normals of the file point the other way.
+            rec.normal = rec.front_face ? n : -n;
+            return true;
+        }
+
+    private:
+        bvh_tree tree;
+        aabb bbox;
+
+        vec3 shading_normal(std::uint32_t k, const real b[3]) const {
+            // the vertex normals interpolated, zero where the triangle has none.
+            if (normal_indices.empty()) return vec3(0,0,0);
+            vec3 n(0,0,0);
+            for (int c = 0; c < 3; c++) {
+                std::uint32_t i = normal_indices[3*k + c];
+                if (i == no_normal) return vec3(0,0,0);
+                n += b[c] * normals[i];
+            }
+            return n.near_zero() ? n : unit_vector(n);
+        }
+};
+
+class mesh_shape {
+    // a mesh with its material, without a vtable. closed_scene stores these by value,
+    // mesh wraps one to make it a hittable. the geometry is owned elsewhere.
+
+    public:
+        const triangle_mesh* geometry;
+        const material* mat;
+
+        mesh_shape(const triangle_mesh* geometry_, const material* mat_) : geometry(geometry_), mat(mat_) {}
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+            return geometry->hit(r, ray_t, rec, mat);
+        }
+
+        aabb bounding_box() const { return geometry->bounding_box(); }
+};
+
+class mesh : public hittable {
+    public:
+        mesh(shared_ptr<const triangle_mesh> geometry_, const material* mat_)
+            : geometry(geometry_), shape(geometry.get(), mat_) {}
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            return shape.hit(r, ray_t, rec);
+        }
+
+        aabb bounding_box() const override { return shape.bounding_box(); }
+
+    private:
+        shared_ptr<const triangle_mesh> geometry; // shared between every mesh using it.
+        mesh_shape shape;
+};
+
+#endif
@@ -0,0 +1,334 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+/*
+    Wavefront OBJ loader for triangle_mesh.
+
+    Only the geometry is read: vertex positions (v), vertex normals (vn) and
+    faces (f, with any of the v, v/vt, v//vn and v/vt/vn corner forms and
+    negative, relative indices). Polygons are split into a fan of
+    triangles. Texture coordinates, groups, smoothing groups and materials
+    are skipped; a mesh gets its material from the scene.
+
+    The file is streamed in blocks of block_size bytes per thread. Each
+    block is cut at line ends into one piece per thread, the pieces are
+    parsed in parallel into their own vertex and face arrays, and those are
+    appended to the mesh in file order. Memory for the text therefore stays
+    at one block whatever the size of the file. A negative index counts
+    back from the vertices read so far, which a piece only knows relative
+    to its own start, so those corners are noted and fixed up once the
+    vertex counts of the pieces before are known. Each piece also notes the
+    corners most likely to be out of range, so a bad index is reported with
+    its line without keeping a line number per corner.
+*/
+
+#include "rtweekend.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class obj_loader {
+    public:
+        static constexpr size_t block_size = size_t(4) << 20;
+
+        explicit obj_loader(int threads_ = 0) : threads(threads_) {
+            if (threads <= 0) threads = int(std::max(1u, std::thread::hardware_concurrency()));
+        }
+
+        bool load(const std::string& path, triangle_mesh& mesh, std::string& error) {
+            // replaces mesh with the geometry in path and builds its bvh.
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                error = "can't open " + path;
+                return false;
+            }
+            mesh = triangle_mesh();
+            bool any_normals = false;
+            index_use highest_vertex{-1, 0}, highest_normal{-1, 0}; // with file lines, checked at the end.
+
+            std::vector<char> block(block_size * size_t(threads));
+            std::vector<piece> pieces(static_cast<size_t>(threads));
+            size_t kept = 0;
+            long lines_before = 0; // lines in the blocks already parsed.
+            while (true) {
+                if (kept == block.size()) block.resize(2 * block.size()); // a very long line.
+                file.read(block.data() + kept, std::streamsize(block.size() - kept));
+                size_t size = kept + size_t(file.gcount());
+                bool at_end = !file;
+                if (at_end && !file.eof()) {
+                    error = "can't read " + path;
+                    return false;
+                }
+
+                size_t lines = size;
+                if (!at_end)
+                    while (lines > 0 && block[lines - 1] != '\n') lines--;
+                std::string_view text(block.data(), lines);
+
+                // one piece per thread, each ending at a line end.
+                std::vector<std::thread> workers;
+                size_t start = 0;
+                for (size_t p = 0; p < pieces.size(); p++) {
+                    size_t end = p + 1 == pieces.size() ? text.size()
+                               : std::max(start, text.size() * (p + 1) / pieces.size());
+                    while (end < text.size() && end > 0 && text[end - 1] != '\n') end++;
+                    pieces[p].text = text.substr(start, end - start);
+                    start = end;
+                    if (p > 0) workers.emplace_back([&pieces, p] { pieces[p].parse(); });
+                }
+                pieces[0].parse();
+                for (auto& w : workers) w.join();
+
+                for (auto& p : pieces) {
+                    auto fail = [&](long piece_line, const std::string& message) {
+                        error = path + ", line " + std::to_string(lines_before + piece_line) + ": " + message;
+                        return false;
+                    };
+                    if (!p.error.empty()) return fail(p.error_line, p.error);
+                    // relative indices can only reach too far back, before the vertices read so far.
+                    if (std::int64_t(mesh.positions.size()) + p.lowest_vertex.index < 0)
+                        return fail(p.lowest_vertex.line, "a face refers to a vertex before the first one");
+                    if (std::int64_t(mesh.normals.size()) + p.lowest_normal.index < 0)
+                        return fail(p.lowest_normal.line, "a face refers to a normal before the first one");
+                    if (!append(p, mesh)) {
+                        error = path + ": too many vertices";
+                        return false;
+                    }
+                    if (p.highest_vertex.index > highest_vertex.index)
+                        highest_vertex = {p.highest_vertex.index, lines_before + p.highest_vertex.line};
+                    if (p.highest_normal.index > highest_normal.index)
+                        highest_normal = {p.highest_normal.index, lines_before + p.highest_normal.line};
+                    any_normals = any_normals || p.any_normals;
+                    lines_before += long(std::count(p.text.begin(), p.text.end(), '\n'));
+                }
+
+                if (at_end) break;
+                kept = size - lines;
+                std::copy(block.begin() + long(lines), block.begin() + long(size), block.begin());
+            }
+
+            // absolute indices may refer to vertices further down the file, so they are only
+            // checked now.
+            auto missing = [&](const index_use& use, const char* what, size_t count) {
+                error = path + ", line " + std::to_string(use.line) + ": a face refers to " + what + " "
+                      + std::to_string(use.index + 1) + ", the file has " + std::to_string(count);
+                return false;
+            };
+            if (highest_vertex.index >= std::int64_t(mesh.positions.size()))
+                return missing(highest_vertex, "vertex", mesh.positions.size());
+            if (highest_normal.index >= std::int64_t(mesh.normals.size()))
+                return missing(highest_normal, "normal", mesh.normals.size());
+            if (!any_normals) mesh.normal_indices.clear();
+            mesh.build();
+            return true;
+        }
+
+    private:
+        int threads;
+
+        struct index_use {
+            std::int64_t index;
+            long line;
+        };
+
+        struct piece {
+            // what one thread parsed of a block.
+            std::string_view text;
+            std::vector<point3> positions;
+            std::vector<vec3> normals;
+            std::vector<std::int64_t> indices; // 0 based, relative ones counted from the start of this piece.
+            std::vector<std::int64_t> normal_indices;
+            std::vector<size_t> relative_indices; // positions in indices that are relative.
+            std::vector<size_t> relative_normal_indices;
+            bool any_normals = false;
+            std::string error;
+            long error_line = 0;
+
+            // the relative indices reaching furthest back (negative once they reach before this
+            // piece) and the highest absolute ones, with the lines they are on.
+            index_use lowest_vertex{0, 0}, lowest_normal{0, 0};
+            index_use highest_vertex{-1, 0}, highest_normal{-1, 0};
+
+            size_t pos = 0;
+            long line = 0;
+
+            void parse() {
+                positions.clear();
+                normals.clear();
+                indices.clear();
+                normal_indices.clear();
+                relative_indices.clear();
+                relative_normal_indices.clear();
+                any_normals = false;
+                error.clear();
+                lowest_vertex = lowest_normal = {0, 0};
+                highest_vertex = highest_normal = {-1, 0};
+                pos = 0;
+
+                line = 0;
+                while (pos < text.size()) {
+                    line++;
+                    if (!parse_line()) {
+                        error_line = line;
+                        return;
+                    }
+                    while (pos < text.size() && text[pos] != '\n') pos++;
+                    pos++;
+                }
+            }
+
+            static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+            std::string_view token() {
+                while (pos < text.size() && is_space(text[pos])) pos++;
+                size_t start = pos;
+                while (pos < text.size() && !is_space(text[pos]) && text[pos] != '\n' && text[pos] != '#') pos++;
+                return text.substr(start, pos - start);
+            }
+
+            bool number(real& value) {
+                auto word = token();
+                auto [end, ec] = std::from_chars(word.data(), word.data() + word.size(), value);
+                if (word.empty() || ec != std::errc() || end != word.data() + word.size()) {
+                    error = word.empty() ? "expected a number" : "expected a number, got '" + std::string(word) + "'";
+                    return false;
+                }
+                return true;
+            }
+
+            bool parse_line() {
+                auto keyword = token();
+                if (keyword == "v") {
+                    real x, y, z;
+                    if (!number(x) || !number(y) || !number(z)) return false;
+                    positions.push_back(point3(x, y, z));
+                } else if (keyword == "vn") {
+                    real x, y, z;
+                    if (!number(x) || !number(y) || !number(z)) return false;
+                    normals.push_back(vec3(x, y, z));
+                } else if (keyword == "f") {
+                    return parse_face();
+                }
+                return true; // anything else isn't geometry.
+            }
+
+            bool corner(std::string_view word, std::int64_t& vertex, std::int64_t& normal) {
+                // "v", "v/vt", "v//vn" or "v/vt/vn". normal is 0 without one.
+                auto field = [&](size_t n) {
+                    size_t begin = 0;
+                    for (size_t k = 0; k < n; k++) {
+                        begin = word.find('/', begin);
+                        if (begin == std::string_view::npos) return std::string_view();
+                        begin++;
+                    }
+                    return word.substr(begin, word.find('/', begin) - begin);
+                };
+                auto index = [&](std::string_view digits, std::int64_t& value) {
+                    auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+                    return !digits.empty() && ec == std::errc() && end == digits.data() + digits.size() && value != 0;
+                };
+                if (!index(field(0), vertex)) return false;
+                auto normal_digits = field(2);
+                normal = 0;
+                if (!normal_digits.empty() && !index(normal_digits, normal)) return false;
+                return true;
+            }
+
+            void add_corner(std::int64_t vertex, std::int64_t normal) {
+                // obj indices start at 1, negative ones count back from the last one read.
+                if (vertex > 0) {
+                    indices.push_back(vertex - 1);
+                    note_highest(highest_vertex, vertex - 1);
+                } else {
+                    relative_indices.push_back(indices.size());
+                    indices.push_back(std::int64_t(positions.size()) + vertex);
+                    note_lowest(lowest_vertex, indices.back());
+                }
+                if (normal == 0) normal_indices.push_back(-1);
+                else if (normal > 0) {
+                    normal_indices.push_back(normal - 1);
+                    note_highest(highest_normal, normal - 1);
+                } else {
+                    relative_normal_indices.push_back(normal_indices.size());
+                    normal_indices.push_back(std::int64_t(normals.size()) + normal);
+                    note_lowest(lowest_normal, normal_indices.back());
+                }
+                if (normal != 0) any_normals = true;
+            }
+
+            void note_lowest(index_use& use, std::int64_t index) const {
+                if (index < use.index) use = {index, line};
+            }
+
+            void note_highest(index_use& use, std::int64_t index) const {
+                if (index > use.index) use = {index, line};
+            }
+
+            bool parse_face() {
+                std::int64_t first[2] = {}, previous[2] = {}, v[2];
+                int corners = 0;
+                for (auto word = token(); !word.empty(); word = token()) {
+                    if (!corner(word, v[0], v[1])) {
+                        error = "bad face corner '" + std::string(word) + "'";
+                        return false;
+                    }
+                    if (v[0] > std::int64_t(triangle_mesh::no_normal) || v[1] > std::int64_t(triangle_mesh::no_normal)) {
+                        error = "index too large in '" + std::string(word) + "'";
+                        return false;
+                    }
+                    if (corners == 0) {
+                        first[0] = v[0];
+                        first[1] = v[1];
+                    } else if (corners >= 2) {
+                        // a fan around the first corner.
+                        add_corner(first[0], first[1]);
+                        add_corner(previous[0], previous[1]);
+                        add_corner(v[0], v[1]);
+                    }
+                    previous[0] = v[0];
+                    previous[1] = v[1];
+                    corners++;
+                }
+                if (corners < 3) {
+                    error = "a face needs at least three corners";
+                    return false;
+                }
+                return true;
+            }
+        };
+
+        static bool append(const piece& p, triangle_mesh& mesh) {
+            // adds p to mesh, with p's relative indices made absolute. load has checked that
+            // none of them reaches before the first vertex. false if there are too many vertices.
+            auto vertex_base = std::int64_t(mesh.positions.size());
+            auto normal_base = std::int64_t(mesh.normals.size());
+            size_t first_index = mesh.indices.size();
+
+            mesh.positions.insert(mesh.positions.end(), p.positions.begin(), p.positions.end());
+            mesh.normals.insert(mesh.normals.end(), p.normals.begin(), p.normals.end());
+            if (mesh.positions.size() >= triangle_mesh::no_normal || mesh.normals.size() >= triangle_mesh::no_normal)
+                return false;
+
+            std::vector<std::int64_t> indices = p.indices, normal_indices = p.normal_indices;
+            for (auto k : p.relative_indices) indices[k] += vertex_base;
+            for (auto k : p.relative_normal_indices) normal_indices[k] += normal_base;
+
+            mesh.indices.reserve(first_index + indices.size());
+            mesh.normal_indices.reserve(first_index + indices.size());
+            for (size_t k = 0; k < indices.size(); k++) {
+                mesh.indices.push_back(std::uint32_t(indices[k]));
+                mesh.normal_indices.push_back(normal_indices[k] < 0 ? triangle_mesh::no_normal
+                                                                    : std::uint32_t(normal_indices[k]));
+            }
+            return true;
+        }
+};
+
+#endif
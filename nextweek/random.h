@@ -0,0 +1,185 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+/*
+    Random number generation.
+
+    Every thread owns its own xoshiro256++ generator, so drawing a number
+    touches no shared state and needs no locking. The state is 32 bytes
+    and one draw is a handful of shifts, rotates and adds, which matters
+    since random_double() is called several times per sample: for the
+    pixel offset and russian roulette in camera.h, and twice per direction
+    by the closed form sphere and disk samplers in vec3.h, at every bounce
+    and for the lens position.
+
+    Generators are seeded through splitmix64 from a global seed plus a
+    per-thread stream number, so threads get unrelated sequences.
+
+    For reproducible renders a thread can instead read from a sample_stream,
+    a counter-based generator (Philox4x32-10) where the n-th number of a
+    sample is a pure function of (seed, pixel, sample, bounce, n). Nothing is
+    carried from one sample to the next, so the image no longer depends on
+    which thread rendered which tile, or in what order. The stream can also
+    take its numbers from a low discrepancy sample_pattern (see sampler.h).
+*/
+
+#include "sampler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+inline std::uint64_t splitmix64(std::uint64_t& x) {
+    // used to expand a single 64 bit seed into a full generator state.
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+class xoshiro256pp {
+    private:
+        std::uint64_t s[4];
+
+        static std::uint64_t rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    public:
+        xoshiro256pp(std::uint64_t seed = 0) { reseed(seed); }
+
+        void reseed(std::uint64_t seed) {
+            for (auto& word : s) word = splitmix64(seed);
+        }
+
+        std::uint64_t next() {
+            const std::uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+            const std::uint64_t t = s[1] << 17;
+
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+
+            return result;
+        }
+
+        // uniform real in [0,1), built from the top 53 (or 24) bits of the output.
+        double next_double() { return double(next() >> 11) * 0x1.0p-53; }
+        float next_float() { return float(next() >> 40) * 0x1.0p-24f; }
+
+        // bulk generation for consumers that want a whole buffer of numbers at once.
+        void fill(double* out, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++) out[i] = next_double();
+        }
+
+        void fill(float* out, std::size_t n) {
+            // every 64 bit output holds two 24 bit floats.
+            std::size_t i = 0;
+            for (; i + 1 < n; i += 2) {
+                auto x = next();
+                out[i] = float(x >> 40) * 0x1.0p-24f;
+                out[i+1] = float((x >> 8) & 0xffffff) * 0x1.0p-24f;
+            }
+            if (i < n) out[i] = next_float();
+        }
+};
+
+inline void philox4x32_10(std::uint32_t ctr[4], std::uint32_t key0, std::uint32_t key1) {
+    // ten rounds of the Philox bijection, the counter is replaced by the output.
+    for (int round = 0; round < 10; round++) {
+        std::uint64_t p0 = std::uint64_t(0xD2511F53u) * ctr[0];
+        std::uint64_t p1 = std::uint64_t(0xCD9E8D57u) * ctr[2];
+        std::uint32_t out0 = std::uint32_t(p1 >> 32) ^ ctr[1] ^ key0;
+        std::uint32_t out2 = std::uint32_t(p0 >> 32) ^ ctr[3] ^ key1;
+        ctr[0] = out0;
+        ctr[1] = std::uint32_t(p1);
+        ctr[2] = out2;
+        ctr[3] = std::uint32_t(p0);
+        key0 += 0x9E3779B9u;
+        key1 += 0xBB67AE85u;
+    }
+}
+
+class sample_stream {
+    private:
+        std::uint64_t seed = 0;
+        std::uint32_t key[2] = {0, 0};
+        std::uint32_t pixel = 0, sample = 0, bounce = 0;
+        std::uint32_t dimension = 0; // next dimension to hand out within the bounce.
+        double spare = 0; // every Philox call (or 2D point) yields two doubles, the second is kept here.
+
+    public:
+        sample_pattern pattern; // where the numbers come from, Philox unless set otherwise.
+
+        void start(std::uint64_t seed_, std::uint32_t pixel_, std::uint32_t sample_) {
+            // begin the stream of one sample of one pixel.
+            seed = seed_;
+            key[0] = std::uint32_t(seed_);
+            key[1] = std::uint32_t(seed_ >> 32);
+            pixel = pixel_;
+            sample = sample_;
+            set_bounce(0);
+        }
+
+        void set_bounce(std::uint32_t bounce_) {
+            // every bounce of the path gets its own run of dimensions.
+            bounce = bounce_;
+            dimension = 0;
+        }
+
+        double next_double() {
+            if (dimension & 1) {
+                dimension++;
+                return spare;
+            }
+            if (pattern.type != sampler_type::independent) {
+                // dimensions go to the pattern in pairs, numbered across the whole path.
+                double first;
+                pattern.sample_2d(seed, pixel, sample, (bounce << 16) | (dimension >> 1), first, spare);
+                dimension++;
+                return first;
+            }
+            std::uint32_t ctr[4] = {pixel, sample, bounce, dimension >> 1};
+            philox4x32_10(ctr, key[0], key[1]);
+            dimension++;
+            spare = double(((std::uint64_t(ctr[2]) << 32) | ctr[3]) >> 11) * 0x1.0p-53;
+            return double(((std::uint64_t(ctr[0]) << 32) | ctr[1]) >> 11) * 0x1.0p-53;
+        }
+};
+
+inline std::atomic<std::uint64_t>& random_seed() {
+    // base seed shared by all threads. change it before any thread draws a number.
+    static std::atomic<std::uint64_t> seed{0x853c49e6748fea9bull};
+    return seed;
+}
+
+inline std::uint64_t next_thread_stream() {
+    static std::atomic<std::uint64_t> streams{0};
+    return streams++;
+}
+
+struct thread_random_state {
+    xoshiro256pp rng;
+    sample_stream stream;
+    bool use_stream = false; // draw from the counter-based stream instead of rng.
+
+    thread_random_state(std::uint64_t seed) : rng(seed) {}
+
+    double next_double() { return use_stream ? stream.next_double() : rng.next_double(); }
+};
+
+inline thread_random_state& thread_random() {
+    // each thread lazily creates its generator on its first draw.
+    thread_local thread_random_state state(random_seed().load() ^ (next_thread_stream() * 0xd1b54a32d192ed03ull));
+    return state;
+}
+
+inline xoshiro256pp& thread_rng() { return thread_random().rng; }
+
+inline void seed_thread_rng(std::uint64_t seed) {
+    // restart the calling thread's generator from a given seed.
+    thread_rng().reseed(seed);
+}
+
+#endif
@@ -13,28 +13,46 @@ any where on the 3D line. For positive t, you can only get
 only parts in front of A, called half-line or ray.
 */
 
-class ray {
+template <typename T>
+class ray_t {
     private:
-        point3 orig;
-        vec3 dir;
-        double tm;
+        vec3_t<T> orig;
+        vec3_t<T> dir;
+        T tm;
 
     public:
-        ray() {}
-        ray(const point3& orig_, const vec3& dire_) :
+        ray_t() {}
+        ray_t(const vec3_t<T>& orig_, const vec3_t<T>& dire_) :
             orig(orig_), dir(dire_){}
 
-        ray(const point3& orig_, const vec3& dire_, double time) :
+        ray_t(const vec3_t<T>& orig_, const vec3_t<T>& dire_, T time) :
             orig(orig_), dir(dire_), tm(time){}
 
-        const point3& origin() const {return orig;}
-        const vec3& direction() const {return dir;}
+        const vec3_t<T>& origin() const {return orig;}
+        const vec3_t<T>& direction() const {return dir;}
 
-        double time() const { return tm; }
+        T time() const { return tm; }
         // returns the position of ray after t intervals. 
-        point3 at(double t) const {
+        vec3_t<T> at(T t) const {
             return orig + t*dir;
         }
 };
 
-#endif
\ No newline at end of file
+using ray = ray_t<real>;
+
+template <typename T>
+inline vec3_t<T> offset_ray_origin(const vec3_t<T>& p, const vec3_t<T>& n, const vec3_t<T>& w) {
+    /*
+        a computed hit point is only accurate to a few ulps of its largest coordinate, so it
+        can land just below the surface and the next ray hits the surface it started on
+        (shadow acne). push the point off the surface along the unit normal n by a bound on
+        that error, to the side the new direction w leaves on. the bound scales with the
+        magnitude of p, so it holds for any scene size and precision.
+    */
+    T largest = std::fmax(std::fabs(p.x()), std::fmax(std::fabs(p.y()), std::fabs(p.z())));
+    T bound = T(64) * std::numeric_limits<T>::epsilon() * (largest + T(1));
+    vec3_t<T> offset = bound * n;
+    return dot(w, n) < 0 ? p - offset : p + offset;
+}
+
+#endif
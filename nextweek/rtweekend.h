@@ -7,11 +7,33 @@
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <type_traits>
+
+#include "random.h"
 
 
 using std::make_shared;
 using std::shared_ptr;
 
+/*
+    scalar type of all geometry, colors and ray math. double by default, build with
+    RT_SINGLE_PRECISION to render in float, which doubles the SIMD width and halves
+    the memory traffic for geometry and the framebuffer.
+*/
+#ifdef RT_SINGLE_PRECISION
+using real = float;
+#else
+using real = double;
+#endif
+
+/*
+    float hit points and sphere roots are not accurate enough for the 0.001 shadow acne
+    epsilon alone, so in single precision the sphere tests use the more stable quadratic
+    and scattered rays start from a point pushed off the surface (offset_ray_origin).
+    double keeps the original math, so its images don't change.
+*/
+constexpr bool robust_geometry = std::is_same_v<real, float>;
+
 // constants
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535;
@@ -22,18 +44,38 @@ inline double degrees_to_radians(double degrees) {
 }
 
 inline double random_double() {
-    // returns a random real number in [0,1)
-    return std::rand()/(RAND_MAX+1.0);
+    // returns a random real number in [0,1), drawn from the calling thread's generator.
+    return thread_random().next_double();
 }
 
 inline double random_double(double min, double max) {
     return min+(max-min)*random_double();
 }
 
+inline void random_doubles(double* out, size_t n) {
+    // fills out[0..n) with random reals in [0,1).
+    auto& state = thread_random();
+    if (state.use_stream) {
+        for (size_t i = 0; i < n; i++) out[i] = state.stream.next_double();
+        return;
+    }
+    state.rng.fill(out, n);
+}
+
+inline void random_floats(float* out, size_t n) {
+    auto& state = thread_random();
+    if (state.use_stream) {
+        for (size_t i = 0; i < n; i++) out[i] = float(state.stream.next_double());
+        return;
+    }
+    state.rng.fill(out, n);
+}
+
 // common headers.
 #include "color.h"
 #include "ray.h"
 #include "vec3.h"
 #include "interval.h"
+#include "stats.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,227 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+/*
+    Low discrepancy sample patterns for the sample_stream.
+
+    The stream hands out the dimensions of one sample as (pixel, sample,
+    bounce, dimension). With the independent sampler every dimension is a
+    fresh Philox number. The samplers here instead take dimensions two at a
+    time and place the pair on a well distributed 2D point set, so the
+    pixel jitter, the lens position and the scatter direction of every
+    bounce are each stratified over the samples of a pixel:
+
+        sobol:  Owen scrambled Sobol (0,2)-sequence. Every pair of
+                dimensions gets its own scramble and its own shuffle of the
+                sample order ("padding"), as in Burley, Practical Hash-based
+                Owen Scrambling (2020). Only the first two Sobol dimensions
+                are used, and both have closed forms, so there are no tables.
+        halton: Halton in bases 2 and 3, Owen scrambled digit by digit, with
+                the sample order shuffled per pair of dimensions like sobol.
+        zsobol: the sobol points, with the sample index of each pixel taken
+                from its Morton (Z curve) order and permuted per base 4 digit
+                (Ahmed and Wonka, Screen-Space Blue-Noise Diffusion of Monte
+                Carlo Sampling Error via Hierarchical Ordering of Pixels,
+                2020). Neighbouring pixels get complementary points, so the
+                remaining error looks like blue noise instead of white noise.
+
+    Sobol and zsobol are at their best with power of two sample counts.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+enum class sampler_type { independent, sobol, halton, zsobol };
+
+inline const char* sampler_name(sampler_type type) {
+    switch (type) {
+        case sampler_type::sobol: return "sobol";
+        case sampler_type::halton: return "halton";
+        case sampler_type::zsobol: return "zsobol";
+        default: return "independent";
+    }
+}
+
+inline bool sampler_type_for(const std::string& name, sampler_type& type) {
+    // false if name isn't a sampler.
+    for (auto candidate : {sampler_type::independent, sampler_type::sobol, sampler_type::halton, sampler_type::zsobol}) {
+        if (name == sampler_name(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::uint64_t mix_bits(std::uint64_t v) {
+    // 64 bit finalizer, used to turn (seed, pixel, dimension) into scramble seeds.
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ull;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= v >> 33;
+    return v;
+}
+
+inline std::uint32_t reverse_bits32(std::uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+inline std::uint32_t laine_karras_permutation(std::uint32_t x, std::uint32_t seed) {
+    // each bit only depends on the bits below it, which is what makes the nested scramble below work.
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+inline std::uint32_t nested_uniform_scramble(std::uint32_t x, std::uint32_t seed) {
+    // Owen scrambling of a 32 bit fixed point value in [0,1): every bit is flipped
+    // depending on the bits above it.
+    return reverse_bits32(laine_karras_permutation(reverse_bits32(x), seed));
+}
+
+inline std::uint32_t sobol_dim0(std::uint32_t index) {
+    return reverse_bits32(index);
+}
+
+inline std::uint32_t sobol_dim1(std::uint32_t index) {
+    // the second Sobol dimension (primitive polynomial x + 1): each direction number
+    // is the previous one xor itself shifted down by one.
+    std::uint32_t result = 0;
+    for (std::uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+        if (index & 1) result ^= v;
+    return result;
+}
+
+inline double owen_radical_inverse3(std::uint32_t index, std::uint64_t seed) {
+    // base 3 radical inverse with every digit permuted depending on the digits before it.
+    static const unsigned char permutations[6][3] = {
+        {0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}
+    };
+    std::uint64_t digits = 0; // scrambled digits so far, most significant first.
+    double scale = 1;
+    int k = 0;
+    for (; index > 0; k++) {
+        std::uint32_t digit = index % 3;
+        index /= 3;
+        digit = permutations[mix_bits(seed ^ (std::uint64_t(k) << 56) ^ digits) % 6][digit];
+        digits = digits * 3 + digit;
+        scale /= 3;
+    }
+    // the digits left are all 0, and scrambled they are uniform given the digits above,
+    // so one hashed number fills them all in.
+    double tail = double(mix_bits(seed ^ (std::uint64_t(k) << 56) ^ digits) >> 11) * 0x1.0p-53;
+    return std::min((double(digits) + tail) * scale, 0x1.fffffffffffffp-1);
+}
+
+inline std::uint64_t encode_morton2(std::uint32_t x, std::uint32_t y) {
+    // interleave the bits of x (even bits) and y (odd bits).
+    auto spread = [](std::uint64_t v) {
+        v &= 0xffffffffull;
+        v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+        v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+        v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+class sample_pattern {
+    public:
+        sampler_type type = sampler_type::independent;
+
+        sample_pattern() {}
+
+        sample_pattern(sampler_type type_, int width_, int height_, int samples_per_pixel)
+            : type(type_), width(std::uint32_t(std::max(width_, 1))) {
+            // halton and zsobol need the sample count (and zsobol the image size) rounded up to
+            // powers of two.
+            int resolution = std::max(width_, height_);
+            while ((1 << log2_resolution) < resolution) log2_resolution++;
+            while ((1 << log2_spp) < samples_per_pixel) log2_spp++;
+            base4_digits = log2_resolution + (log2_spp + 1) / 2;
+        }
+
+        int layout_log2_spp() const {
+            // log2 of the sample count the points are laid out for. independent and sobol
+            // points don't depend on it, so it is 0 for them.
+            return type == sampler_type::halton || type == sampler_type::zsobol ? log2_spp : 0;
+        }
+
+        void sample_2d(std::uint64_t seed, std::uint32_t pixel, std::uint32_t sample,
+                std::uint32_t pair, double& u, double& v) const {
+            // point number `sample` of pixel `pixel` for one pair of dimensions. pair numbers
+            // the pairs of the whole path, so every pair gets unrelated scrambles.
+            std::uint64_t pair_seed = mix_bits(seed ^ mix_bits((std::uint64_t(pixel) << 32) | pair));
+
+            if (type == sampler_type::halton) {
+                // keep the shuffled index below the sample count, so the base 3 digits run out early.
+                std::uint32_t index = nested_uniform_scramble(sample, std::uint32_t(pair_seed >> 32));
+                index &= (std::uint32_t(1) << log2_spp) - 1;
+                u = to_unit(nested_uniform_scramble(reverse_bits32(index), std::uint32_t(pair_seed)));
+                v = owen_radical_inverse3(index, mix_bits(pair_seed));
+                return;
+            }
+
+            std::uint32_t index, scramble;
+            if (type == sampler_type::zsobol) {
+                // the scramble is shared by all pixels here, the decorrelation comes from the index.
+                index = zsobol_index(pixel, sample, pair);
+                scramble = std::uint32_t(mix_bits(seed ^ pair));
+            } else {
+                index = nested_uniform_scramble(sample, std::uint32_t(pair_seed));
+                scramble = std::uint32_t(pair_seed >> 32);
+            }
+            u = to_unit(nested_uniform_scramble(sobol_dim0(index), scramble));
+            v = to_unit(nested_uniform_scramble(sobol_dim1(index), scramble ^ 0x9e3779b9u));
+        }
+
+    private:
+        std::uint32_t width = 1;
+        int log2_resolution = 0;
+        int log2_spp = 0;
+        int base4_digits = 0;
+
+        static double to_unit(std::uint32_t x) { return double(x) * 0x1.0p-32; }
+
+        std::uint32_t zsobol_index(std::uint32_t pixel, std::uint32_t sample, std::uint32_t pair) const {
+            // Morton index of the pixel with the sample number appended, and each base 4 digit
+            // permuted depending on the digits above it (and the pair of dimensions).
+            static const unsigned char permutations[24][4] = {
+                {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 2, 1}, {0, 3, 1, 2},
+                {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 2, 0}, {1, 3, 0, 2},
+                {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 3, 0, 1}, {2, 3, 1, 0},
+                {3, 1, 2, 0}, {3, 1, 0, 2}, {3, 2, 1, 0}, {3, 2, 0, 1}, {3, 0, 2, 1}, {3, 0, 1, 2}
+            };
+            std::uint64_t morton = (encode_morton2(pixel % width, pixel / width) << log2_spp) | sample;
+            std::uint64_t salt = 0x55555555ull * pair;
+
+            // an odd log2_spp leaves one base 2 digit at the bottom.
+            bool odd = log2_spp & 1;
+            std::uint64_t index = 0;
+            for (int i = base4_digits - 1; i >= (odd ? 1 : 0); i--) {
+                int shift = 2*i - (odd ? 1 : 0);
+                int digit = int((morton >> shift) & 3);
+                std::uint64_t higher = morton >> (shift + 2);
+                digit = permutations[(mix_bits(higher ^ salt) >> 24) % 24][digit];
+                index |= std::uint64_t(digit) << shift;
+            }
+            if (odd) index |= (morton & 1) ^ (mix_bits((morton >> 1) ^ salt) & 1);
+
+            // only the low 32 bits reach the 32 bit Sobol points.
+            return std::uint32_t(index);
+        }
+};
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef SCENE_BINARY_H
+#define SCENE_BINARY_H
+
+/*
+    Binary scene files, made to be memory mapped and rendered in place.
+
+    A text scene (scene_file.h) has to be parsed and every sphere allocated
+    before the first ray. A binary scene is the flat arrays the renderer
+    traverses, already laid out: mapped_scene maps the file and points its
+    bvh and sphere tests straight at the mapped pages, so opening even a
+    huge scene costs a bounds check of the arrays, and the pages are read
+    in by the first rays that need them. Only the materials are rebuilt, in
+    one array, since they need their vtables.
+
+    File layout, native byte order, every array starting on a 64 byte
+    boundary (from the start of the file, which mmap puts on a page):
+        binary_scene_header      "RTSCN002" magic and version, sizeof(real)
+                                 the arrays were written with, the camera,
+                                 array counts and offsets
+        packed_material[]        kind, albedo, fuzz, refraction index
+        packed_sphere[]          center, radius, material index, in bvh leaf
+                                 order when there is a bvh
+        bvh_flat_node[]          the flattened bvh over the spheres, or none
+        uint32 indices[]         its primitive index array
+
+    A file without a bvh gets one built when it is opened. Files are not
+    portable between float and double builds, which the header checks.
+    The packed structs spell out their padding as fields written as 0, so
+    the same scene always gives the same bytes.
+*/
+
+#include "rtweekend.h"
+#include "bvh.h"
+#include "camera.h"
+#include "material.h"
+#include "scene_description.h"
+#include "sphere.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+struct binary_scene_camera {
+    double aspect_ratio, vfov, defocus_angle, focus_dist;
+    double lookfrom[3], lookat[3], vup[3];
+    std::int32_t image_width, samples_per_pixel, max_depth, russian_roulette_depth;
+
+    static binary_scene_camera from(const camera& cam) {
+        binary_scene_camera c;
+        c.aspect_ratio = cam.aspect_ratio;
+        c.vfov = cam.vfov;
+        c.defocus_angle = cam.defocus_angle;
+        c.focus_dist = cam.focus_dist;
+        for (int a = 0; a < 3; a++) {
+            c.lookfrom[a] = cam.lookfrom[a];
+            c.lookat[a] = cam.lookat[a];
+            c.vup[a] = cam.vup[a];
+        }
+        c.image_width = cam.image_width;
+        c.samples_per_pixel = cam.samples_per_pixel;
+        c.max_depth = cam.max_depth;
+        c.russian_roulette_depth = cam.russian_roulette_depth;
+        return c;
+    }
+
+    void apply(camera& cam) const {
+        cam.aspect_ratio = aspect_ratio;
+        cam.vfov = vfov;
+        cam.defocus_angle = defocus_angle;
+        cam.focus_dist = focus_dist;
+        cam.lookfrom = point3(lookfrom[0], lookfrom[1], lookfrom[2]);
+        cam.lookat = point3(lookat[0], lookat[1], lookat[2]);
+        cam.vup = vec3(vup[0], vup[1], vup[2]);
+        cam.image_width = image_width;
+        cam.samples_per_pixel = samples_per_pixel;
+        cam.max_depth = max_depth;
+        cam.russian_roulette_depth = russian_roulette_depth;
+    }
+};
+
+struct binary_scene_header {
+    char magic[8];
+    std::uint32_t real_size;
+    std::uint32_t reserved;
+    binary_scene_camera camera;
+    std::uint64_t material_count, sphere_count, node_count; // node_count is 0 without a bvh.
+    std::uint64_t materials_offset, spheres_offset, nodes_offset, indices_offset;
+
+    static constexpr const char* magic_value = "RTSCN002";
+};
+
+struct packed_material {
+    std::uint32_t kind; // a material_kind.
+    std::uint32_t pad; // 0.
+    real albedo[3];
+    real fuzz;
+    real refraction_index;
+};
+
+struct packed_sphere {
+    real center[3];
+    real radius;
+    std::uint32_t material;
+    std::uint32_t pad; // 0.
+};
+
+// no padding the compiler could fill with whatever was in memory, in float or double.
+static_assert(sizeof(binary_scene_camera) == 13*sizeof(double) + 4*sizeof(std::int32_t));
+static_assert(sizeof(binary_scene_header) == 16 + sizeof(binary_scene_camera) + 7*sizeof(std::uint64_t));
+static_assert(sizeof(packed_material) == 2*sizeof(std::uint32_t) + 5*sizeof(real));
+static_assert(sizeof(packed_sphere) == 4*sizeof(real) + 2*sizeof(std::uint32_t));
+
+inline bool is_binary_scene(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    in.read(magic, 8);
+    return in && std::memcmp(magic, binary_scene_header::magic_value, 8) == 0;
+}
+
+inline bool save_binary_scene(const std::string& path, const scene_description& scene, const camera& cam,
+        bool with_bvh = true) {
+    // with_bvh builds the bvh now and stores it, so opening the file doesn't have to.
+    if (!scene.meshes.empty() || !scene.instances.empty()) return false; // only spheres have a binary form.
+    std::vector<packed_material> materials;
+    materials.reserve(scene.materials.size());
+    for (const auto& m : scene.materials)
+        materials.push_back({std::uint32_t(m.kind), 0, {m.albedo.x(), m.albedo.y(), m.albedo.z()},
+                             m.fuzz, m.refraction_index});
+
+    bvh_tree tree;
+    if (with_bvh) {
+        std::vector<aabb> boxes;
+        boxes.reserve(scene.spheres.size());
+        for (const auto& s : scene.spheres) boxes.push_back(sphere_shape(s.center, s.radius, nullptr).bounding_box());
+        tree.build(boxes);
+    }
+
+    // spheres in leaf order, so a leaf's spheres are next to each other in the file.
+    std::vector<packed_sphere> spheres;
+    spheres.reserve(scene.spheres.size());
+    for (size_t k = 0; k < scene.spheres.size(); k++) {
+        const auto& s = scene.spheres[with_bvh ? tree.indices[k] : k];
+        spheres.push_back({{s.center.x(), s.center.y(), s.center.z()}, s.radius, s.material, 0});
+        if (with_bvh) tree.indices[k] = std::uint32_t(k);
+    }
+
+    auto aligned = [](std::uint64_t offset) { return (offset + 63) & ~std::uint64_t(63); };
+    binary_scene_header header{};
+    std::memcpy(header.magic, binary_scene_header::magic_value, 8);
+    header.real_size = sizeof(real);
+    header.camera = binary_scene_camera::from(cam);
+    header.material_count = materials.size();
+    header.sphere_count = spheres.size();
+    header.node_count = tree.nodes.size();
+    header.materials_offset = aligned(sizeof(header));
+    header.spheres_offset = aligned(header.materials_offset + materials.size() * sizeof(packed_material));
+    header.nodes_offset = aligned(header.spheres_offset + spheres.size() * sizeof(packed_sphere));
+    header.indices_offset = aligned(header.nodes_offset + tree.nodes.size() * sizeof(bvh_flat_node));
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    std::uint64_t written = 0;
+    auto write_at = [&](std::uint64_t offset, const void* data, size_t bytes) {
+        static const char zeros[64] = {};
+        out.write(zeros, std::streamsize(offset - written));
+        out.write(static_cast<const char*>(data), std::streamsize(bytes));
+        written = offset + bytes;
+    };
+    write_at(0, &header, sizeof(header));
+    write_at(header.materials_offset, materials.data(), materials.size() * sizeof(packed_material));
+    write_at(header.spheres_offset, spheres.data(), spheres.size() * sizeof(packed_sphere));
+    write_at(header.nodes_offset, tree.nodes.data(), tree.nodes.size() * sizeof(bvh_flat_node));
+    write_at(header.indices_offset, tree.indices.data(), tree.indices.size() * sizeof(std::uint32_t));
+    return bool(out);
+}
+
+class mapped_file {
+    // a whole file mapped read only, unmapped again on destruction.
+    public:
+        mapped_file() {}
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        ~mapped_file() { close(); }
+
+        bool open(const std::string& path) {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void* p = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    bytes = static_cast<const unsigned char*>(p);
+                    length = size_t(info.st_size);
+                }
+            }
+            ::close(fd); // the mapping keeps the file.
+            return bytes != nullptr;
+        }
+
+        void close() {
+            if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+            bytes = nullptr;
+            length = 0;
+        }
+
+        const unsigned char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        const unsigned char* bytes = nullptr;
+        size_t length = 0;
+};
+
+class mapped_scene {
+    /*
+        a world for camera::render over a mapped binary scene. hit runs the bvh and sphere
+        tests on the mapped arrays, scatter dispatches on the material kind like closed_scene.
+        must not be moved once opened, the hit records point into materials.
+    */
+    public:
+        mapped_scene() {}
+        mapped_scene(const mapped_scene&) = delete;
+        mapped_scene& operator=(const mapped_scene&) = delete;
+
+        bool open(const std::string& path, camera& cam, std::string& error) {
+            // maps the file and sets the camera from it. error says what's wrong if it fails.
+            if (!file.open(path)) return fail(error, "can't map " + path);
+            if (file.size() < sizeof(binary_scene_header)) return fail(error, path + " is truncated");
+            const auto& header = *reinterpret_cast<const binary_scene_header*>(file.data());
+            if (std::memcmp(header.magic, binary_scene_header::magic_value, 8) != 0)
+                return fail(error, path + " isn't a binary scene");
+            if (header.real_size != sizeof(real))
+                return fail(error, path + " was written by a " + (header.real_size == 4 ? "float" : "double")
+                                   + " build");
+
+            if (!map_array(header.materials_offset, header.material_count, packed_materials)
+                || !map_array(header.spheres_offset, header.sphere_count, spheres)
+                || !map_array(header.nodes_offset, header.node_count, tree.nodes)
+                || !map_array(header.indices_offset, header.node_count ? header.sphere_count : 0, tree.indices)
+                || header.sphere_count > UINT32_MAX || header.node_count > UINT32_MAX)
+                return fail(error, path + " is truncated or corrupt");
+            sphere_count = size_t(header.sphere_count);
+            tree.node_count = size_t(header.node_count);
+
+            if (!valid(size_t(header.material_count))) return fail(error, path + " is corrupt");
+
+            build_materials(size_t(header.material_count));
+            if (tree.node_count == 0 && sphere_count > 0) {
+                // no bvh stored, build one over the mapped spheres.
+                std::vector<aabb> boxes;
+                boxes.reserve(sphere_count);
+                for (size_t k = 0; k < sphere_count; k++) boxes.push_back(shape(k).bounding_box());
+                built.build(boxes);
+                tree = built.view();
+            }
+
+            header.camera.apply(cam);
+            return true;
+        }
+
+        size_t size() const { return sphere_count; }
+
+        std::uint64_t hash() const {
+            // of the mapped materials and spheres, like scene_description::hash. the spheres
+            // are in the file's order, so it differs from the hash of the text scene.
+            scene_hasher h;
+            h.add(materials.size());
+            for (size_t k = 0; k < materials.size(); k++) {
+                const auto& m = packed_materials[k];
+                h.add(m.kind);
+                for (auto x : m.albedo) h.add(x);
+                h.add(m.fuzz);
+                h.add(m.refraction_index);
+            }
+            h.add(sphere_count);
+            for (size_t k = 0; k < sphere_count; k++) {
+                for (auto x : spheres[k].center) h.add(x);
+                h.add(spheres[k].radius);
+                h.add(spheres[k].material);
+            }
+            return h.value;
+        }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const {
+            return tree.hit(r, ray_t, [&](std::uint32_t i, interval& t) {
+                if (!shape(i).hit(r, t, rec)) return false;
+                rec.mat = materials[spheres[i].material];
+                t.max = rec.t;
+                return true;
+            });
+        }
+
+        static bool scatter(const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) {
+            return scatter_closed(*rec.mat, r_in, rec, attenuation, scattered);
+        }
+
+    private:
+        mapped_file file;
+        const packed_material* packed_materials = nullptr;
+        const packed_sphere* spheres = nullptr;
+        size_t sphere_count = 0;
+        bvh_view tree;
+        bvh_tree built; // the bvh, if the file has none.
+
+        std::vector<std::variant<lambertian, metal, dielectric>> material_store;
+        std::vector<const material*> materials; // by material index, into material_store.
+
+        bool fail(std::string& error, const std::string& what) {
+            // back to an empty scene, which hits nothing.
+            tree = bvh_view();
+            spheres = nullptr;
+            sphere_count = 0;
+            file.close();
+            error = what;
+            return false;
+        }
+
+        template <typename T>
+        bool map_array(std::uint64_t offset, std::uint64_t count, const T*& array) const {
+            // points array at count Ts at offset, if they are inside the file and aligned.
+            if (offset % alignof(T) != 0 || offset > file.size()) return false;
+            if (count > (file.size() - offset) / sizeof(T)) return false;
+            array = reinterpret_cast<const T*>(file.data() + offset);
+            return true;
+        }
+
+        sphere_shape shape(size_t k) const {
+            const auto& s = spheres[k];
+            return sphere_shape(point3(s.center[0], s.center[1], s.center[2]), s.radius, nullptr);
+        }
+
+        bool valid(size_t material_count) const {
+            // every index in range and the tree no deeper than the traversal stack, so a bad
+            // file is turned away here instead of crashing a render.
+            for (size_t k = 0; k < material_count; k++) {
+                auto kind = packed_materials[k].kind;
+                if (kind != std::uint32_t(material_kind::lambertian) && kind != std::uint32_t(material_kind::metal)
+                    && kind != std::uint32_t(material_kind::dielectric)) return false;
+            }
+            for (size_t k = 0; k < sphere_count; k++)
+                if (spheres[k].material >= material_count) return false;
+            if (tree.node_count == 0) return true;
+
+            for (size_t k = 0; k < sphere_count; k++)
+                if (tree.indices[k] >= sphere_count) return false;
+
+            // children come after their parent in the flattened order, so one forward sweep
+            // sees every node's depth before its children's.
+            std::vector<std::uint8_t> depth(tree.node_count);
+            for (size_t k = 0; k < tree.node_count; k++) {
+                const auto& node = tree.nodes[k];
+                if (depth[k] >= bvh_view::max_depth - 1) return false;
+                if (node.count > 0) {
+                    if (std::uint64_t(node.offset) + node.count > sphere_count) return false;
+                    continue;
+                }
+                if (node.axis > 2 || node.offset <= k + 1 || node.offset >= tree.node_count) return false;
+                depth[k + 1] = std::max(depth[k + 1], std::uint8_t(depth[k] + 1));
+                depth[node.offset] = std::max(depth[node.offset], std::uint8_t(depth[k] + 1));
+            }
+            return true;
+        }
+
+        void build_materials(size_t count) {
+            material_store.clear();
+            material_store.reserve(count);
+            materials.clear();
+            materials.reserve(count);
+            for (size_t k = 0; k < count; k++) {
+                const auto& m = packed_materials[k];
+                color albedo(m.albedo[0], m.albedo[1], m.albedo[2]);
+                switch (material_kind(m.kind)) {
+                    case material_kind::metal: material_store.emplace_back(metal(albedo, m.fuzz)); break;
+                    case material_kind::dielectric: material_store.emplace_back(dielectric(m.refraction_index)); break;
+                    default: material_store.emplace_back(lambertian(albedo)); break;
+                }
+                materials.push_back(std::visit([](const auto& mat) -> const material* { return &mat; },
+                                               material_store.back()));
+            }
+        }
+};
+
+#endif
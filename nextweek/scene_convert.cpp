@@ -0,0 +1,74 @@
+/*
+    Converts a text scene file (scene_file.h) into a binary one
+    (scene_binary.h) that the renderer maps and uses in place, so large
+    scenes can be baked once instead of parsed on every start.
+
+    usage: scene_convert [--no-bvh] IN OUT
+
+    IN can also be the name of a preset from scenes.h. The bvh is built and
+    stored in OUT unless --no-bvh is given, in which case it is built every
+    time the file is opened.
+*/
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "scene_binary.h"
+#include "scene_description.h"
+#include "scene_file.h"
+#include "scenes.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    bool with_bvh = true;
+    std::string paths[2];
+    int path_count = 0;
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        if (arg == "--no-bvh") with_bvh = false;
+        else if (path_count < 2 && arg.rfind("--", 0) != 0) paths[path_count++] = arg;
+        else path_count = 3;
+    }
+    if (path_count != 2) {
+        std::cerr << "usage: scene_convert [--no-bvh] IN OUT\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    scene_description scene;
+    camera cam;
+    scene_id preset;
+    if (scene_id_for(paths[0], preset)) {
+        set_scene_view(preset, cam);
+        cam.image_width = 1200;
+        cam.samples_per_pixel = 500;
+        cam.max_depth = 50;
+        scene = preset_scene(preset);
+    }
+    else {
+        std::string error;
+        if (!load_scene(paths[0], scene, cam, error)) {
+            std::cerr << "Can't load scene: " << error << ".\n";
+            return 1;
+        }
+    }
+    std::chrono::duration<double> load = std::chrono::steady_clock::now() - start;
+
+    if (!scene.meshes.empty() || !scene.instances.empty()) {
+        std::cerr << "Binary scenes only hold spheres, " << paths[0] << " has meshes or instances.\n";
+        return 1;
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (!save_binary_scene(paths[1], scene, cam, with_bvh)) {
+        std::cerr << "Can't write " << paths[1] << ".\n";
+        return 1;
+    }
+    std::chrono::duration<double> save = std::chrono::steady_clock::now() - start;
+
+    std::cerr << scene.spheres.size() << " spheres, " << scene.materials.size() << " materials, loaded in "
+              << load.count() << " s, written " << (with_bvh ? "with" : "without") << " bvh in "
+              << save.count() << " s.\n";
+}
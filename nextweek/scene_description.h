@@ -0,0 +1,327 @@
+#ifndef SCENE_DESCRIPTION_H
+#define SCENE_DESCRIPTION_H
+
+/*
+    A scene as plain data: a table of materials and lists of spheres and
+    triangle meshes that refer to them by index, plus objects (spheres and
+    meshes in an object space of their own) placed by instances, each with
+    a transform and optionally a material replacing the object's. The
+    presets in scenes.h and scene files (see scene_file.h) both produce
+    one, and build_world turns it into something the camera renders,
+    either virtual spheres under a bvh with the materials in a
+    material_table (or, with build_batch_world, all of them in one
+    sphere_batch), or a closed_scene. Spheres sharing a
+    material index share one material object. The virtual spheres and their
+    materials are all placed in one scene_arena (see arena.h), which lives
+    as long as the world and the material table point into it. A mesh's
+    geometry is loaded once and shared by whatever is built from it, and an
+    object is built once however many instances it has (see instance.h).
+*/
+
+#include "rtweekend.h"
+#include "arena.h"
+#include "bvh.h"
+#include "closed_scene.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "material.h"
+#include "mesh.h"
+#include "sphere.h"
+#include "sphere_batch.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+class scene_hasher {
+    // 64 bit FNV-1a over the bytes of the values added, to tell scenes apart (see scene_description::hash).
+    public:
+        std::uint64_t value = 14695981039346656037ull;
+
+        template <typename T>
+        void add(const T& x) {
+            static_assert(std::is_arithmetic_v<T>);
+            unsigned char bytes[sizeof(T)];
+            std::memcpy(bytes, &x, sizeof(T));
+            for (auto b : bytes) value = (value ^ b) * 1099511628211ull;
+        }
+
+        void add(const vec3& v) {
+            add(v.x());
+            add(v.y());
+            add(v.z());
+        }
+
+        template <typename T>
+        void add_all(const std::vector<T>& values) {
+            add(values.size());
+            for (const auto& x : values) add(x);
+        }
+};
+
+struct material_description {
+    material_kind kind;
+    color albedo;           // lambertian and metal.
+    real fuzz;              // metal.
+    real refraction_index;  // dielectric.
+
+    template <typename F>
+    decltype(auto) visit(F&& f) const {
+        // calls f with the material this describes.
+        switch (kind) {
+            case material_kind::metal: return f(metal(albedo, fuzz));
+            case material_kind::dielectric: return f(dielectric(refraction_index));
+            default: return f(lambertian(albedo));
+        }
+    }
+};
+
+inline material_description lambertian_material(const color& albedo) {
+    return {material_kind::lambertian, albedo, 0, 0};
+}
+
+inline material_description metal_material(const color& albedo, real fuzz) {
+    return {material_kind::metal, albedo, fuzz, 0};
+}
+
+inline material_description dielectric_material(real refraction_index) {
+    return {material_kind::dielectric, color(0,0,0), 0, refraction_index};
+}
+
+struct sphere_description {
+    point3 center;
+    real radius;
+    std::uint32_t material; // index into scene_description::materials.
+};
+
+struct mesh_description {
+    std::string path; // the obj file the geometry came from.
+    shared_ptr<const triangle_mesh> geometry;
+    std::uint32_t material;
+};
+
+struct object_description {
+    // geometry for instances to place.
+    std::vector<sphere_description> spheres;
+    std::vector<mesh_description> meshes;
+};
+
+struct instance_description {
+    static constexpr std::uint32_t object_materials = UINT32_MAX;
+
+    std::uint32_t object; // index into scene_description::objects.
+    affine_transform to_world; // has to be invertible.
+    std::uint32_t material; // replaces the materials of the object, unless it is object_materials.
+};
+
+struct scene_description {
+    std::vector<material_description> materials;
+    std::vector<sphere_description> spheres;
+    std::vector<mesh_description> meshes;
+    std::vector<object_description> objects;
+    std::vector<instance_description> instances;
+
+    std::uint32_t add_material(const material_description& mat) {
+        materials.push_back(mat);
+        return std::uint32_t(materials.size() - 1);
+    }
+
+    void add_sphere(const point3& center, real radius, std::uint32_t material) {
+        spheres.push_back({center, radius, material});
+    }
+
+    void add_sphere(const point3& center, real radius, const material_description& mat) {
+        // a sphere with a material of its own.
+        add_sphere(center, radius, add_material(mat));
+    }
+
+    void add_mesh(const std::string& path, shared_ptr<const triangle_mesh> geometry, std::uint32_t material) {
+        meshes.push_back({path, geometry, material});
+    }
+
+    std::uint32_t add_object() {
+        objects.emplace_back();
+        return std::uint32_t(objects.size() - 1);
+    }
+
+    void add_instance(std::uint32_t object, const affine_transform& to_world,
+            std::uint32_t material = instance_description::object_materials) {
+        instances.push_back({object, to_world, material});
+    }
+
+    size_t primitive_count() const {
+        // spheres and triangles placed directly, and one per instance, whatever its object holds.
+        size_t count = spheres.size() + instances.size();
+        for (const auto& m : meshes) count += m.geometry->triangle_count();
+        return count;
+    }
+
+    std::uint64_t hash() const {
+        /*
+            a hash of everything here that shows in the image, so a checkpoint can tell which
+            scene it belongs to (see camera::scene_hash). meshes count by their geometry, not
+            the path it came from, so hashing a big mesh reads every triangle of it.
+        */
+        scene_hasher h;
+        h.add(materials.size());
+        for (const auto& m : materials) {
+            h.add(std::uint32_t(m.kind));
+            h.add(m.albedo);
+            h.add(m.fuzz);
+            h.add(m.refraction_index);
+        }
+        auto add_part = [&](const auto& part) {
+            h.add(part.spheres.size());
+            for (const auto& s : part.spheres) {
+                h.add(s.center);
+                h.add(s.radius);
+                h.add(s.material);
+            }
+            h.add(part.meshes.size());
+            for (const auto& m : part.meshes) {
+                h.add_all(m.geometry->positions);
+                h.add_all(m.geometry->normals);
+                h.add_all(m.geometry->indices);
+                h.add_all(m.geometry->normal_indices);
+                h.add(m.material);
+            }
+        };
+        add_part(*this);
+        h.add(objects.size());
+        for (const auto& object : objects) add_part(object);
+        h.add(instances.size());
+        for (const auto& inst : instances) {
+            h.add(inst.object);
+            for (const auto& row : inst.to_world.m)
+                for (auto x : row) h.add(x);
+            h.add(inst.material);
+        }
+        return h.value;
+    }
+
+    void clear() {
+        materials.clear();
+        spheres.clear();
+        meshes.clear();
+        objects.clear();
+        instances.clear();
+    }
+};
+
+template <typename Part>
+void add_shapes(const Part& part, const std::vector<const material*>& mats, std::vector<const hittable*>& list,
+        scene_arena& arena) {
+    // the spheres and meshes of a scene or an object. only a bvh holds them, so they are plain
+    // pointers into the arena: a shared_ptr from make() would keep the arena alive from inside it.
+    for (const auto& s : part.spheres)
+        list.push_back(arena.create<sphere>(s.center, s.radius, mats[s.material]));
+    for (const auto& m : part.meshes)
+        list.push_back(arena.create<mesh>(m.geometry, mats[m.material]));
+}
+
+template <typename Part>
+void add_shapes(const Part& part, const std::vector<const material*>& mats, closed_scene& world) {
+    world.primitives.reserve(world.primitives.size() + part.spheres.size() + part.meshes.size());
+    for (const auto& s : part.spheres)
+        world.add(sphere_shape(s.center, s.radius, mats[s.material]));
+    for (const auto& m : part.meshes)
+        world.add(m.geometry, mats[m.material]);
+}
+
+inline const material* instance_material(const instance_description& inst, const std::vector<const material*>& mats) {
+    return inst.material == instance_description::object_materials ? nullptr : mats[inst.material];
+}
+
+inline std::vector<const material*> add_materials(const scene_description& scene, material_table& materials,
+        scene_arena& arena) {
+    // the scene's materials, in the arena and owned by materials, by material index.
+    std::vector<const material*> mats;
+    mats.reserve(scene.materials.size());
+    for (const auto& desc : scene.materials)
+        mats.push_back(desc.visit([&](const auto& mat) {
+            using M = std::decay_t<decltype(mat)>;
+            return materials.add(arena.make<M>(mat));
+        }));
+    return mats;
+}
+
+inline void add_instances(const scene_description& scene, const std::vector<const material*>& mats,
+        std::vector<const hittable*>& list, scene_arena& arena) {
+    // all the instances as one instance_bvh over a bvh_node per object, if there are any.
+    if (scene.instances.empty()) return;
+    instance_tree<hittable> instances;
+    for (const auto& object : scene.objects) {
+        std::vector<const hittable*> parts;
+        add_shapes(object, mats, parts, arena);
+        instances.add_geometry(arena.create<bvh_node>(parts));
+    }
+    for (const auto& inst : scene.instances)
+        instances.add(inst.object, inst.to_world, instance_material(inst, mats));
+    list.push_back(arena.create<instance_bvh>(std::move(instances)));
+}
+
+inline void build_world(const scene_description& scene, hittable_list& world, material_table& materials,
+        scene_arena arena = scene_arena()) {
+    /*
+        virtual spheres and meshes under a bvh, allocated in arena. materials owns the
+        materials. the instances are one more primitive of that bvh, an instance_bvh over
+        a bvh_node per object.
+    */
+    auto mats = add_materials(scene, materials, arena);
+
+    std::vector<const hittable*> objects;
+    objects.reserve(scene.spheres.size() + scene.meshes.size() + 1);
+    add_shapes(scene, mats, objects, arena);
+    add_instances(scene, mats, objects, arena);
+    world = hittable_list(arena.make<bvh_node>(objects));
+}
+
+inline void build_batch_world(const scene_description& scene, hittable_list& world, material_table& materials,
+        scene_arena arena = scene_arena()) {
+    /*
+        every sphere in one sphere_batch, tested against every ray without a bvh (see
+        sphere_batch.h). the meshes and instances, which a batch can't hold, go under a
+        bvh next to it. fast for a few hundred spheres, hopeless for a million.
+    */
+    auto mats = add_materials(scene, materials, arena);
+
+    auto batch = arena.make<sphere_batch>();
+    for (const auto& s : scene.spheres)
+        batch->add(s.center, s.radius, mats[s.material]);
+    world = hittable_list(batch);
+
+    std::vector<const hittable*> others;
+    for (const auto& m : scene.meshes)
+        others.push_back(arena.create<mesh>(m.geometry, mats[m.material]));
+    add_instances(scene, mats, others, arena);
+    if (!others.empty()) world.add(arena.make<bvh_node>(others));
+}
+
+inline void build_world(const scene_description& scene, closed_scene& world) {
+    std::vector<const material*> mats;
+    mats.reserve(scene.materials.size());
+    for (const auto& desc : scene.materials)
+        mats.push_back(desc.visit([&](const auto& mat) { return world.add_material(mat); }));
+
+    add_shapes(scene, mats, world);
+
+    if (!scene.instances.empty()) {
+        // a closed_scene per object, using the materials of world.
+        auto instances = std::make_shared<instance_tree<closed_scene>>();
+        for (const auto& object : scene.objects) {
+            auto parts = std::make_shared<closed_scene>();
+            add_shapes(object, mats, *parts);
+            parts->build();
+            instances->add_geometry(parts);
+        }
+        for (const auto& inst : scene.instances)
+            instances->add(inst.object, inst.to_world, instance_material(inst, mats));
+        instances->build();
+        world.add(instances);
+    }
+    world.build();
+}
+
+#endif
@@ -0,0 +1,471 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+/*
+    Text scene files: the camera, the materials, the spheres, the meshes
+    and the instanced objects of a scene, one statement per line. '#'
+    starts a comment.
+
+        camera lookfrom 13 2 3 lookat 0 0 0 vfov 20
+        material ground lambertian 0.5 0.5 0.5
+        material gold metal 0.8 0.6 0.2 0.3
+        material glass dielectric 1.5
+        sphere 0 -1000 0 1000 ground
+        sphere 4 1 0 1 metal 0.7 0.6 0.5 0
+        mesh models/bunny.obj gold
+        object pair
+            sphere 0 0.2 0 0.2 ground
+            sphere 0 0.5 0 0.1 glass
+        end
+        instance pair scale 2 rotate 0 1 0 45 translate 3 0 -2
+        instance pair translate -3 0 -2 material metal 0.9 0.9 0.9 0
+
+    camera sets any of the camera's public view and sampling fields by name
+    (aspect_ratio, image_width, samples_per_pixel, max_depth,
+    russian_roulette_depth, vfov, lookfrom, lookat, vup, defocus_angle,
+    focus_dist), several to a line if need be; fields a file leaves out keep
+    the camera's value. A sphere or mesh names a material declared before
+    it, or gives one of its own inline, so the names lambertian, metal and
+    dielectric can't be used for materials. A mesh is an OBJ file (see
+    obj_loader.h), its path relative to the scene file and without spaces;
+    meshes naming the same file share one copy of the geometry.
+
+    The spheres and meshes between object NAME and end make up an object,
+    which isn't in the scene itself but placed by the instances naming it
+    (see instance.h). An instance applies its transforms in the order they
+    are written: translate x y z, rotate x y z degrees (about an axis
+    through the origin), scale s or scale x y z, and matrix with the 12
+    numbers of a 3x4 affine matrix row by row. After material, an
+    instance gives a material that replaces all of the object's.
+
+    The loader reads the file a block of lines at a time and parses it in
+    one pass, numbers straight out of the block with std::from_chars, so a
+    million sphere scene loads in a fraction of a second and the text never
+    has to fit in memory all at once. save_scene writes a scene back
+    out (numbers in their shortest exact form, so it reloads bit for bit),
+    which turns the presets into files.
+*/
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "obj_loader.h"
+#include "scene_description.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+class scene_parser {
+    public:
+        // mesh paths are relative to directory.
+        scene_parser(scene_description& scene_, camera& cam_, std::filesystem::path directory_ = {})
+            : scene(scene_), cam(cam_), directory(std::move(directory_)) {}
+
+        bool parse(std::string_view lines, std::string& error) {
+            // parses whole lines, the next call carries on after them. error is "line N: what
+            // went wrong" when this returns false.
+            text = lines;
+            pos = 0;
+            while (pos < text.size()) {
+                line_number++;
+                if (!parse_line()) {
+                    error = "line " + std::to_string(line_number) + ": " + message;
+                    return false;
+                }
+                // on to the start of the next line.
+                while (pos < text.size() && text[pos] != '\n') pos++;
+                pos++;
+            }
+            return true;
+        }
+
+        bool finish(std::string& error) {
+            // after the last line, false if it left an object open.
+            if (current_object == no_object) return true;
+            error = "line " + std::to_string(object_line) + ": object has no end";
+            return false;
+        }
+
+    private:
+        static constexpr std::uint32_t no_object = UINT32_MAX;
+
+        std::string_view text; // the lines being parsed.
+        scene_description& scene;
+        camera& cam;
+        std::filesystem::path directory;
+        size_t pos = 0;
+        int line_number = 0;
+        std::string message;
+        std::unordered_map<std::string, std::uint32_t> material_names;
+        std::unordered_map<std::string, shared_ptr<const triangle_mesh>> loaded_meshes; // by path.
+        std::unordered_map<std::string, std::uint32_t> object_names;
+        std::uint32_t current_object = no_object; // the object being defined.
+        int object_line = 0; // where it started.
+
+        static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        std::string_view token() {
+            // the next word on this line, empty at the end of the line or at a comment.
+            while (pos < text.size() && is_space(text[pos])) pos++;
+            size_t start = pos;
+            while (pos < text.size() && !is_space(text[pos]) && text[pos] != '\n' && text[pos] != '#') pos++;
+            return text.substr(start, pos - start);
+        }
+
+        bool fail(const std::string& what) {
+            message = what;
+            return false;
+        }
+
+        template <typename T>
+        bool number(T& value) {
+            auto word = token();
+            auto [end, ec] = std::from_chars(word.data(), word.data() + word.size(), value);
+            if (word.empty() || ec != std::errc() || end != word.data() + word.size())
+                return fail(word.empty() ? "expected a number" : "expected a number, got '" + std::string(word) + "'");
+            return true;
+        }
+
+        bool number(vec3& v) {
+            real x, y, z;
+            if (!number(x) || !number(y) || !number(z)) return false;
+            v = vec3(x, y, z);
+            return true;
+        }
+
+        bool parse_line() {
+            auto keyword = token();
+            bool ok;
+            if (keyword.empty()) return true;
+            else if (keyword == "sphere") ok = parse_sphere();
+            else if (keyword == "mesh") ok = parse_mesh();
+            else if (keyword == "object") ok = parse_object();
+            else if (keyword == "end") ok = parse_end();
+            else if (keyword == "instance") ok = parse_instance();
+            else if (keyword == "material") ok = parse_material_declaration();
+            else if (keyword == "camera") ok = parse_camera();
+            else return fail("unknown statement '" + std::string(keyword) + "'");
+            if (!ok) return false;
+
+            auto rest = token();
+            if (!rest.empty()) return fail("unexpected '" + std::string(rest) + "'");
+            return true;
+        }
+
+        bool parse_material(std::string_view kind, material_description& mat) {
+            // the parameters following a material kind.
+            color albedo;
+            real value;
+            if (kind == "lambertian") {
+                if (!number(albedo)) return false;
+                mat = lambertian_material(albedo);
+            } else if (kind == "metal") {
+                if (!number(albedo) || !number(value)) return false;
+                mat = metal_material(albedo, value);
+            } else if (kind == "dielectric") {
+                if (!number(value)) return false;
+                mat = dielectric_material(value);
+            } else {
+                return fail("unknown material kind '" + std::string(kind) + "'");
+            }
+            return true;
+        }
+
+        static bool is_material_kind(std::string_view word) {
+            return word == "lambertian" || word == "metal" || word == "dielectric";
+        }
+
+        bool parse_material_declaration() {
+            auto name = token();
+            if (name.empty()) return fail("material needs a name");
+            if (is_material_kind(name)) return fail("'" + std::string(name) + "' can't be a material name");
+
+            material_description mat;
+            if (!parse_material(token(), mat)) return false;
+            // a redeclared name refers to the new material from here on.
+            material_names[std::string(name)] = scene.add_material(mat);
+            return true;
+        }
+
+        bool parse_material_use(const char* statement, std::uint32_t& material) {
+            // a declared material's name or an inline material.
+            auto name = token();
+            if (is_material_kind(name)) {
+                material_description mat;
+                if (!parse_material(name, mat)) return false;
+                material = scene.add_material(mat);
+                return true;
+            }
+
+            auto found = material_names.find(std::string(name));
+            if (found == material_names.end())
+                return fail(name.empty() ? std::string(statement) + " needs a material"
+                                         : "unknown material '" + std::string(name) + "'");
+            material = found->second;
+            return true;
+        }
+
+        bool parse_sphere() {
+            point3 center;
+            real radius;
+            std::uint32_t material;
+            if (!number(center) || !number(radius) || !parse_material_use("sphere", material)) return false;
+            if (current_object == no_object) scene.add_sphere(center, radius, material);
+            else scene.objects[current_object].spheres.push_back({center, radius, material});
+            return true;
+        }
+
+        bool parse_mesh() {
+            auto name = token();
+            if (name.empty()) return fail("mesh needs a file");
+            std::uint32_t material;
+            if (!parse_material_use("mesh", material)) return false;
+
+            std::string path = (directory / std::string(name)).lexically_normal().string();
+            auto& geometry = loaded_meshes[path];
+            if (!geometry) {
+                auto loaded = std::make_shared<triangle_mesh>();
+                std::string error;
+                if (!obj_loader().load(path, *loaded, error)) return fail(error);
+                geometry = loaded;
+            }
+            if (current_object == no_object) scene.add_mesh(path, geometry, material);
+            else scene.objects[current_object].meshes.push_back({path, geometry, material});
+            return true;
+        }
+
+        bool parse_object() {
+            auto name = token();
+            if (name.empty()) return fail("object needs a name");
+            if (current_object != no_object) return fail("objects can't be nested");
+            // a redeclared name refers to the new object from here on.
+            current_object = scene.add_object();
+            object_names[std::string(name)] = current_object;
+            object_line = line_number;
+            return true;
+        }
+
+        bool parse_end() {
+            if (current_object == no_object) return fail("end without object");
+            current_object = no_object;
+            return true;
+        }
+
+        bool parse_instance() {
+            if (current_object != no_object) return fail("instances can't be inside an object");
+            auto name = token();
+            auto found = object_names.find(std::string(name));
+            if (found == object_names.end())
+                return fail(name.empty() ? "instance needs an object" : "unknown object '" + std::string(name) + "'");
+
+            affine_transform to_world;
+            std::uint32_t material = instance_description::object_materials;
+            for (auto word = token(); !word.empty(); word = token()) {
+                vec3 v;
+                real value;
+                if (word == "translate") {
+                    if (!number(v)) return false;
+                    to_world = affine_transform::translate(v) * to_world;
+                } else if (word == "rotate") {
+                    if (!number(v) || !number(value)) return false;
+                    if (v.near_zero()) return fail("rotate needs an axis");
+                    to_world = affine_transform::rotate(v, value) * to_world;
+                } else if (word == "scale") {
+                    if (!number(value)) return false;
+                    v = vec3(value, value, value);
+                    size_t uniform = pos;
+                    auto next = token();
+                    real y;
+                    pos = uniform;
+                    if (std::from_chars(next.data(), next.data() + next.size(), y).ec == std::errc()) {
+                        // scale x y z.
+                        real z;
+                        if (!number(y) || !number(z)) return false;
+                        v = vec3(value, y, z);
+                    }
+                    to_world = affine_transform::scale(v) * to_world;
+                } else if (word == "matrix") {
+                    affine_transform m;
+                    for (int i = 0; i < 3; i++)
+                        for (int j = 0; j < 4; j++)
+                            if (!number(m.m[i][j])) return false;
+                    to_world = m * to_world;
+                } else if (word == "material") {
+                    if (!parse_material_use("instance", material)) return false;
+                    break;
+                } else {
+                    return fail("unknown transform '" + std::string(word) + "'");
+                }
+            }
+            if (!to_world.invertible()) return fail("instance transform can't be inverted");
+            scene.add_instance(found->second, to_world, material);
+            return true;
+        }
+
+        bool parse_camera() {
+            // field value pairs up to the end of the line.
+            for (auto field = token(); !field.empty(); field = token()) {
+                bool ok;
+                if (field == "aspect_ratio") ok = number(cam.aspect_ratio);
+                else if (field == "image_width") ok = number(cam.image_width);
+                else if (field == "samples_per_pixel") ok = number(cam.samples_per_pixel);
+                else if (field == "max_depth") ok = number(cam.max_depth);
+                else if (field == "russian_roulette_depth") ok = number(cam.russian_roulette_depth);
+                else if (field == "vfov") ok = number(cam.vfov);
+                else if (field == "lookfrom") ok = number(cam.lookfrom);
+                else if (field == "lookat") ok = number(cam.lookat);
+                else if (field == "vup") ok = number(cam.vup);
+                else if (field == "defocus_angle") ok = number(cam.defocus_angle);
+                else if (field == "focus_dist") ok = number(cam.focus_dist);
+                else return fail("unknown camera field '" + std::string(field) + "'");
+                if (!ok) return false;
+            }
+            return true;
+        }
+};
+
+inline bool load_scene(const std::string& path, scene_description& scene, camera& cam, std::string& error) {
+    // adds the file's materials, spheres and meshes to scene and sets the camera fields it names.
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "can't open " + path;
+        return false;
+    }
+
+    scene_parser parser(scene, cam, std::filesystem::path(path).parent_path());
+    std::vector<char> block(1 << 20);
+    size_t kept = 0; // the start of a line the last block cut off.
+    while (true) {
+        if (kept == block.size()) block.resize(2 * block.size()); // a very long line.
+        file.read(block.data() + kept, std::streamsize(block.size() - kept));
+        size_t size = kept + size_t(file.gcount());
+        bool at_end = !file;
+        if (at_end && !file.eof()) {
+            error = "can't read " + path;
+            return false;
+        }
+
+        // parse up to the last full line, the rest goes in front of the next block.
+        size_t lines = size;
+        if (!at_end) {
+            while (lines > 0 && block[lines - 1] != '\n') lines--;
+        }
+        if (!parser.parse(std::string_view(block.data(), lines), error) || (at_end && !parser.finish(error))) {
+            error = path + ", " + error;
+            return false;
+        }
+        if (at_end) return true;
+        kept = size - lines;
+        std::copy(block.begin() + long(lines), block.begin() + long(size), block.begin());
+    }
+}
+
+class scene_text_writer {
+    // numbers in their shortest form that parses back to the same value.
+    public:
+        explicit scene_text_writer(std::ostream& out_) : out(out_) {}
+
+        template <typename T>
+        scene_text_writer& operator<<(T value) {
+            if constexpr (std::is_floating_point_v<T> || std::is_same_v<T, int>) {
+                char digits[32];
+                auto result = std::to_chars(digits, digits + sizeof(digits), value);
+                out << ' ';
+                out.write(digits, result.ptr - digits);
+            } else {
+                out << value;
+            }
+            return *this;
+        }
+
+        scene_text_writer& operator<<(const vec3& v) { return *this << v.x() << v.y() << v.z(); }
+
+    private:
+        std::ostream& out;
+};
+
+inline void write_material(scene_text_writer& w, const material_description& mat) {
+    switch (mat.kind) {
+        case material_kind::metal: w << " metal" << mat.albedo << mat.fuzz; break;
+        case material_kind::dielectric: w << " dielectric" << mat.refraction_index; break;
+        default: w << " lambertian" << mat.albedo; break;
+    }
+}
+
+inline bool save_scene(const std::string& path, const scene_description& scene, const camera& cam) {
+    std::ofstream file(path);
+    if (!file) return false;
+    scene_text_writer w(file);
+
+    w << "camera aspect_ratio" << cam.aspect_ratio << " image_width" << cam.image_width
+      << " samples_per_pixel" << cam.samples_per_pixel << " max_depth" << cam.max_depth
+      << " russian_roulette_depth" << cam.russian_roulette_depth << '\n';
+    w << "camera vfov" << cam.vfov << " lookfrom" << cam.lookfrom << " lookat" << cam.lookat
+      << " vup" << cam.vup << '\n';
+    w << "camera defocus_angle" << cam.defocus_angle << " focus_dist" << cam.focus_dist << '\n';
+
+    // a material only one sphere, mesh or instance uses is written inline with it, the others by name.
+    std::vector<std::uint32_t> users(scene.materials.size());
+    auto count_users = [&](const auto& part) {
+        for (const auto& s : part.spheres) users[s.material]++;
+        for (const auto& m : part.meshes) users[m.material]++;
+    };
+    count_users(scene);
+    for (const auto& object : scene.objects) count_users(object);
+    for (const auto& inst : scene.instances)
+        if (inst.material != instance_description::object_materials) users[inst.material]++;
+    for (size_t m = 0; m < scene.materials.size(); m++) {
+        if (users[m] == 1) continue;
+        w << "material m" + std::to_string(m);
+        write_material(w, scene.materials[m]);
+        w << '\n';
+    }
+
+    auto write_use = [&](std::uint32_t m) {
+        if (users[m] == 1) write_material(w, scene.materials[m]);
+        else w << " m" + std::to_string(m);
+        w << '\n';
+    };
+    // mesh paths are written relative to where the file goes.
+    auto directory = std::filesystem::absolute(path).parent_path();
+    auto write_part = [&](const auto& part, const char* indent) {
+        for (const auto& s : part.spheres) {
+            w << indent << "sphere" << s.center << s.radius;
+            write_use(s.material);
+        }
+        for (const auto& m : part.meshes) {
+            w << indent << "mesh " << std::filesystem::absolute(m.path).lexically_proximate(directory).string();
+            write_use(m.material);
+        }
+    };
+
+    write_part(scene, "");
+    for (size_t k = 0; k < scene.objects.size(); k++) {
+        w << "object o" + std::to_string(k) << '\n';
+        write_part(scene.objects[k], "    ");
+        w << "end\n";
+    }
+    for (const auto& inst : scene.instances) {
+        w << "instance o" + std::to_string(inst.object);
+        if (!(inst.to_world == affine_transform())) {
+            w << " matrix";
+            for (const auto& row : inst.to_world.m)
+                for (real value : row) w << value;
+        }
+        if (inst.material == instance_description::object_materials) w << '\n';
+        else {
+            w << " material";
+            write_use(inst.material);
+        }
+    }
+    return bool(file);
+}
+
+#endif
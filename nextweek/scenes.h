@@ -0,0 +1,201 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+/*
+    Named scene presets, shared by the renderer and the benchmark harness.
+
+        random:        the book's final scene, a field of about 480 small
+                       spheres around three big ones.
+        material_test: ground, a diffuse sphere, a glass sphere with an
+                       air bubble and a fuzzy metal sphere, from chapter 12.
+        dense:         a 100 x 100 grid of small spheres with random
+                       materials, 10001 primitives in all, for the bvh.
+        instanced:     a 100 x 100 grid of instances of one cluster of
+                       nine spheres, each turned and scaled at random and
+                       half of them in a material of their own, for the
+                       two level bvh (see instance.h).
+
+    Each preset is a function calling add_sphere(center, radius, material)
+    for every sphere, which preset_scene collects into a scene_description
+    (see scene_description.h), plus the camera view it is meant to be seen
+    from. The spheres are drawn from the calling thread's generator, which
+    is seeded first, so a preset is the same scene every time. instanced
+    needs objects and instances, so it builds its scene_description itself.
+*/
+
+#include "rtweekend.h"
+#include "camera.h"
+#include "scene_description.h"
+
+#include <string>
+
+enum class scene_id { random, material_test, dense, instanced };
+
+inline const char* scene_name(scene_id id) {
+    switch (id) {
+        case scene_id::material_test: return "material_test";
+        case scene_id::dense: return "dense";
+        case scene_id::instanced: return "instanced";
+        default: return "random";
+    }
+}
+
+inline bool scene_id_for(const std::string& name, scene_id& id) {
+    // false if name isn't a preset.
+    for (auto candidate : {scene_id::random, scene_id::material_test, scene_id::dense, scene_id::instanced}) {
+        if (name == scene_name(candidate)) {
+            id = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename AddSphere>
+void random_scene(AddSphere&& add_sphere) {
+    // every sphere has a material of its own.
+
+    add_sphere(point3(0,-1000, 0), 1000, lambertian_material(color(0.5, 0.5, 0.5)));
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++){
+            auto choose_mat = random_double();
+            point3 center(a + 0.9*random_double(), 0.2, b + 0.9*random_double());
+
+            if ((center- point3(4,0.2, 0)).length() > 0.9) {
+
+                if (choose_mat < 0.8) {
+                    // diffuse
+                    auto albedo = color::random() * color::random();
+                    add_sphere(center, 0.2, lambertian_material(albedo));
+                }
+                else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = color::random(0.5,1);
+                    auto fuzz = random_double(0,0.5);
+                    add_sphere(center, 0.2, metal_material(albedo, fuzz));
+                }
+                else {
+                    // glass
+                    add_sphere(center, 0.2, dielectric_material(1.5));
+                }
+            }
+        }
+    }
+
+    add_sphere(point3(0,1,0), 1.0, dielectric_material(1.5));
+    add_sphere(point3(-4, 1,0), 1.0, lambertian_material(color(.04, 0.2, 0.1)));
+    add_sphere(point3(4,1,0), 1.0, metal_material(color(0.7, 0.6, 0.5), 0.0));
+}
+
+template <typename AddSphere>
+void material_test_scene(AddSphere&& add_sphere) {
+    add_sphere(point3(0,-100.5,-1.0), 100.0, lambertian_material(color(0.8, 0.8, 0.0)));
+    add_sphere(point3(0, 0.0, -1.2), 0.5, lambertian_material(color(0.1, 0.2, 0.5)));
+    add_sphere(point3(-1.0, 0.0, -1.0), 0.5, dielectric_material(1.5));
+    add_sphere(point3(-1.0, 0.0, -1.0), 0.4, dielectric_material(1.0/1.5)); // air bubble inside the glass.
+    add_sphere(point3(1.0, 0.0, -1.0), 0.5, metal_material(color(0.8, 0.6, 0.2), 1.0));
+}
+
+template <typename AddSphere>
+void dense_scene(AddSphere&& add_sphere, int per_side = 100) {
+    // per_side^2 spheres on a half unit grid, same material mix as the random field.
+    add_sphere(point3(0,-1000, 0), 1000, lambertian_material(color(0.5, 0.5, 0.5)));
+
+    for (int a = 0; a < per_side; a++) {
+        for (int b = 0; b < per_side; b++) {
+            auto choose_mat = random_double();
+            point3 center(0.5*(a - per_side/2) + 0.2*random_double(), 0.15,
+                          0.5*(b - per_side/2) + 0.2*random_double());
+            if (choose_mat < 0.8)
+                add_sphere(center, 0.15, lambertian_material(color::random() * color::random()));
+            else if (choose_mat < 0.95)
+                add_sphere(center, 0.15, metal_material(color::random(0.5,1), random_double(0,0.5)));
+            else
+                add_sphere(center, 0.15, dielectric_material(1.5));
+        }
+    }
+}
+
+inline void instanced_scene(scene_description& scene, int per_side = 100) {
+    scene.add_sphere(point3(0,-1000, 0), 1000, lambertian_material(color(0.5, 0.5, 0.5)));
+
+    // a ring of eight small metal spheres around a bigger diffuse one, resting on y = 0.
+    auto cluster = scene.add_object();
+    auto core = scene.add_material(lambertian_material(color(0.8, 0.3, 0.1)));
+    auto ring = scene.add_material(metal_material(color(0.8, 0.8, 0.9), 0.1));
+    auto& parts = scene.objects[cluster];
+    parts.spheres.push_back({point3(0, 0.12, 0), 0.12, core});
+    for (int k = 0; k < 8; k++) {
+        double angle = 2*pi*k/8;
+        parts.spheres.push_back({point3(0.18*std::cos(angle), 0.05, 0.18*std::sin(angle)), 0.05, ring});
+    }
+
+    for (int a = 0; a < per_side; a++) {
+        for (int b = 0; b < per_side; b++) {
+            point3 position(0.5*(a - per_side/2) + 0.1*random_double(), 0,
+                            0.5*(b - per_side/2) + 0.1*random_double());
+            auto to_world = affine_transform::translate(position)
+                          * affine_transform::rotate(vec3(0,1,0), random_double(0,360))
+                          * affine_transform::scale(vec3(1,1,1) * random_double(0.8,1.2));
+
+            auto choose_mat = random_double();
+            if (choose_mat < 0.5)
+                scene.add_instance(cluster, to_world);
+            else if (choose_mat < 0.85)
+                scene.add_instance(cluster, to_world,
+                                   scene.add_material(lambertian_material(color::random() * color::random())));
+            else
+                scene.add_instance(cluster, to_world,
+                                   scene.add_material(metal_material(color::random(0.5,1), random_double(0,0.5))));
+        }
+    }
+}
+
+inline scene_description preset_scene(scene_id id) {
+    // the spheres of a preset, always the same ones: the random numbers start from the
+    // sequence the first thread of the program gets, as the scenes were always built.
+    scene_description scene;
+    auto add_sphere = [&](const point3& center, real radius, const material_description& mat) {
+        scene.add_sphere(center, radius, mat);
+    };
+    seed_thread_rng(random_seed().load());
+    switch (id) {
+        case scene_id::material_test: material_test_scene(add_sphere); break;
+        case scene_id::dense: dense_scene(add_sphere); break;
+        case scene_id::instanced: instanced_scene(scene); break;
+        default: random_scene(add_sphere); break;
+    }
+    return scene;
+}
+
+inline void set_scene_view(scene_id id, camera& cam) {
+    // the view a preset is meant to be seen from. leaves size and sampling alone.
+    cam.aspect_ratio = 16.0/9.0;
+    cam.vup = vec3(0,1,0);
+    if (id == scene_id::material_test) {
+        cam.vfov = 20;
+        cam.lookfrom = point3(-2,2,1);
+        cam.lookat = point3(0,0,-1);
+        cam.defocus_angle = 10.0;
+        cam.focus_dist = 3.4;
+        return;
+    }
+    cam.vfov = 20;
+    cam.lookfrom = point3(13,2,3);
+    cam.lookat = point3(0,0,0);
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 10.0;
+}
+
+inline void build_world(scene_id id, hittable_list& world, material_table& materials,
+        scene_arena arena = scene_arena()) {
+    // the preset as virtual spheres under a bvh. materials owns the materials.
+    build_world(preset_scene(id), world, materials, arena);
+}
+
+inline void build_world(scene_id id, closed_scene& world) {
+    build_world(preset_scene(id), world);
+}
+
+#endif
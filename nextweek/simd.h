@@ -0,0 +1,265 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*
+    Thin wrapper over the widest vector unit the compiler targets, so kernels
+    can be written once against simd_double / simd_float and get 8/16 lanes
+    with AVX-512, 4/8 with AVX, 2/4 with SSE2, or plain scalar code.
+
+    Only what the intersection kernels and the output pass in color.h need is
+    wrapped: lane-wise arithmetic, comparisons producing a mask, and a select
+    on that mask.
+*/
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <type_traits>
+
+#if defined(__AVX512F__)
+
+struct simd_double {
+    static constexpr int width = 8;
+    static constexpr const char* isa = "avx512";
+    __m512d v;
+
+    struct mask { __mmask8 m; };
+
+    static simd_double load(const double* p) { return {_mm512_loadu_pd(p)}; }
+    static simd_double broadcast(double x) { return {_mm512_set1_pd(x)}; }
+    void store(double* p) const { _mm512_storeu_pd(p, v); }
+};
+
+inline simd_double operator+(simd_double a, simd_double b) { return {_mm512_add_pd(a.v, b.v)}; }
+inline simd_double operator-(simd_double a, simd_double b) { return {_mm512_sub_pd(a.v, b.v)}; }
+inline simd_double operator*(simd_double a, simd_double b) { return {_mm512_mul_pd(a.v, b.v)}; }
+inline simd_double operator/(simd_double a, simd_double b) { return {_mm512_div_pd(a.v, b.v)}; }
+// the full-mask forms avoid gcc 12 -Wmaybe-uninitialized noise from _mm512_undefined_pd.
+inline simd_double simd_sqrt(simd_double a) { return {_mm512_mask_sqrt_pd(a.v, __mmask8(0xff), a.v)}; }
+inline simd_double simd_max(simd_double a, simd_double b) { return {_mm512_mask_max_pd(a.v, __mmask8(0xff), a.v, b.v)}; }
+inline simd_double simd_min(simd_double a, simd_double b) { return {_mm512_mask_min_pd(a.v, __mmask8(0xff), a.v, b.v)}; }
+
+inline simd_double::mask operator<(simd_double a, simd_double b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ)}; }
+inline simd_double::mask operator<=(simd_double a, simd_double b) { return {_mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ)}; }
+inline simd_double::mask operator&(simd_double::mask a, simd_double::mask b) { return {__mmask8(a.m & b.m)}; }
+inline simd_double::mask operator|(simd_double::mask a, simd_double::mask b) { return {__mmask8(a.m | b.m)}; }
+
+// per lane: m ? a : b
+inline simd_double simd_select(simd_double::mask m, simd_double a, simd_double b) { return {_mm512_mask_blend_pd(m.m, b.v, a.v)}; }
+inline bool simd_any(simd_double::mask m) { return m.m != 0; }
+
+struct simd_float {
+    static constexpr int width = 16;
+    static constexpr const char* isa = "avx512";
+    __m512 v;
+
+    struct mask { __mmask16 m; };
+
+    static simd_float load(const float* p) { return {_mm512_loadu_ps(p)}; }
+    static simd_float broadcast(float x) { return {_mm512_set1_ps(x)}; }
+    void store(float* p) const { _mm512_storeu_ps(p, v); }
+};
+
+inline simd_float operator+(simd_float a, simd_float b) { return {_mm512_add_ps(a.v, b.v)}; }
+inline simd_float operator-(simd_float a, simd_float b) { return {_mm512_sub_ps(a.v, b.v)}; }
+inline simd_float operator*(simd_float a, simd_float b) { return {_mm512_mul_ps(a.v, b.v)}; }
+inline simd_float operator/(simd_float a, simd_float b) { return {_mm512_div_ps(a.v, b.v)}; }
+inline simd_float simd_sqrt(simd_float a) { return {_mm512_mask_sqrt_ps(a.v, __mmask16(0xffff), a.v)}; }
+inline simd_float simd_max(simd_float a, simd_float b) { return {_mm512_mask_max_ps(a.v, __mmask16(0xffff), a.v, b.v)}; }
+inline simd_float simd_min(simd_float a, simd_float b) { return {_mm512_mask_min_ps(a.v, __mmask16(0xffff), a.v, b.v)}; }
+
+inline simd_float::mask operator<(simd_float a, simd_float b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)}; }
+inline simd_float::mask operator<=(simd_float a, simd_float b) { return {_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)}; }
+inline simd_float::mask operator&(simd_float::mask a, simd_float::mask b) { return {__mmask16(a.m & b.m)}; }
+inline simd_float::mask operator|(simd_float::mask a, simd_float::mask b) { return {__mmask16(a.m | b.m)}; }
+
+inline simd_float simd_select(simd_float::mask m, simd_float a, simd_float b) { return {_mm512_mask_blend_ps(m.m, b.v, a.v)}; }
+inline bool simd_any(simd_float::mask m) { return m.m != 0; }
+
+#elif defined(__AVX__)
+
+struct simd_double {
+    static constexpr int width = 4;
+    static constexpr const char* isa = "avx";
+    __m256d v;
+
+    struct mask { __m256d m; };
+
+    static simd_double load(const double* p) { return {_mm256_loadu_pd(p)}; }
+    static simd_double broadcast(double x) { return {_mm256_set1_pd(x)}; }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+};
+
+inline simd_double operator+(simd_double a, simd_double b) { return {_mm256_add_pd(a.v, b.v)}; }
+inline simd_double operator-(simd_double a, simd_double b) { return {_mm256_sub_pd(a.v, b.v)}; }
+inline simd_double operator*(simd_double a, simd_double b) { return {_mm256_mul_pd(a.v, b.v)}; }
+inline simd_double operator/(simd_double a, simd_double b) { return {_mm256_div_pd(a.v, b.v)}; }
+inline simd_double simd_sqrt(simd_double a) { return {_mm256_sqrt_pd(a.v)}; }
+inline simd_double simd_max(simd_double a, simd_double b) { return {_mm256_max_pd(a.v, b.v)}; }
+inline simd_double simd_min(simd_double a, simd_double b) { return {_mm256_min_pd(a.v, b.v)}; }
+
+inline simd_double::mask operator<(simd_double a, simd_double b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+inline simd_double::mask operator<=(simd_double a, simd_double b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)}; }
+inline simd_double::mask operator&(simd_double::mask a, simd_double::mask b) { return {_mm256_and_pd(a.m, b.m)}; }
+inline simd_double::mask operator|(simd_double::mask a, simd_double::mask b) { return {_mm256_or_pd(a.m, b.m)}; }
+
+inline simd_double simd_select(simd_double::mask m, simd_double a, simd_double b) { return {_mm256_blendv_pd(b.v, a.v, m.m)}; }
+inline bool simd_any(simd_double::mask m) { return _mm256_movemask_pd(m.m) != 0; }
+
+struct simd_float {
+    static constexpr int width = 8;
+    static constexpr const char* isa = "avx";
+    __m256 v;
+
+    struct mask { __m256 m; };
+
+    static simd_float load(const float* p) { return {_mm256_loadu_ps(p)}; }
+    static simd_float broadcast(float x) { return {_mm256_set1_ps(x)}; }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline simd_float operator+(simd_float a, simd_float b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline simd_float operator-(simd_float a, simd_float b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline simd_float operator*(simd_float a, simd_float b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline simd_float operator/(simd_float a, simd_float b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline simd_float simd_sqrt(simd_float a) { return {_mm256_sqrt_ps(a.v)}; }
+inline simd_float simd_max(simd_float a, simd_float b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline simd_float simd_min(simd_float a, simd_float b) { return {_mm256_min_ps(a.v, b.v)}; }
+
+inline simd_float::mask operator<(simd_float a, simd_float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline simd_float::mask operator<=(simd_float a, simd_float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline simd_float::mask operator&(simd_float::mask a, simd_float::mask b) { return {_mm256_and_ps(a.m, b.m)}; }
+inline simd_float::mask operator|(simd_float::mask a, simd_float::mask b) { return {_mm256_or_ps(a.m, b.m)}; }
+
+inline simd_float simd_select(simd_float::mask m, simd_float a, simd_float b) { return {_mm256_blendv_ps(b.v, a.v, m.m)}; }
+inline bool simd_any(simd_float::mask m) { return _mm256_movemask_ps(m.m) != 0; }
+
+#elif defined(__SSE2__)
+
+struct simd_double {
+    static constexpr int width = 2;
+    static constexpr const char* isa = "sse2";
+    __m128d v;
+
+    struct mask { __m128d m; };
+
+    static simd_double load(const double* p) { return {_mm_loadu_pd(p)}; }
+    static simd_double broadcast(double x) { return {_mm_set1_pd(x)}; }
+    void store(double* p) const { _mm_storeu_pd(p, v); }
+};
+
+inline simd_double operator+(simd_double a, simd_double b) { return {_mm_add_pd(a.v, b.v)}; }
+inline simd_double operator-(simd_double a, simd_double b) { return {_mm_sub_pd(a.v, b.v)}; }
+inline simd_double operator*(simd_double a, simd_double b) { return {_mm_mul_pd(a.v, b.v)}; }
+inline simd_double operator/(simd_double a, simd_double b) { return {_mm_div_pd(a.v, b.v)}; }
+inline simd_double simd_sqrt(simd_double a) { return {_mm_sqrt_pd(a.v)}; }
+inline simd_double simd_max(simd_double a, simd_double b) { return {_mm_max_pd(a.v, b.v)}; }
+inline simd_double simd_min(simd_double a, simd_double b) { return {_mm_min_pd(a.v, b.v)}; }
+
+inline simd_double::mask operator<(simd_double a, simd_double b) { return {_mm_cmplt_pd(a.v, b.v)}; }
+inline simd_double::mask operator<=(simd_double a, simd_double b) { return {_mm_cmple_pd(a.v, b.v)}; }
+inline simd_double::mask operator&(simd_double::mask a, simd_double::mask b) { return {_mm_and_pd(a.m, b.m)}; }
+inline simd_double::mask operator|(simd_double::mask a, simd_double::mask b) { return {_mm_or_pd(a.m, b.m)}; }
+
+inline simd_double simd_select(simd_double::mask m, simd_double a, simd_double b) {
+    return {_mm_or_pd(_mm_and_pd(m.m, a.v), _mm_andnot_pd(m.m, b.v))};
+}
+inline bool simd_any(simd_double::mask m) { return _mm_movemask_pd(m.m) != 0; }
+
+struct simd_float {
+    static constexpr int width = 4;
+    static constexpr const char* isa = "sse2";
+    __m128 v;
+
+    struct mask { __m128 m; };
+
+    static simd_float load(const float* p) { return {_mm_loadu_ps(p)}; }
+    static simd_float broadcast(float x) { return {_mm_set1_ps(x)}; }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline simd_float operator+(simd_float a, simd_float b) { return {_mm_add_ps(a.v, b.v)}; }
+inline simd_float operator-(simd_float a, simd_float b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline simd_float operator*(simd_float a, simd_float b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline simd_float operator/(simd_float a, simd_float b) { return {_mm_div_ps(a.v, b.v)}; }
+inline simd_float simd_sqrt(simd_float a) { return {_mm_sqrt_ps(a.v)}; }
+inline simd_float simd_max(simd_float a, simd_float b) { return {_mm_max_ps(a.v, b.v)}; }
+inline simd_float simd_min(simd_float a, simd_float b) { return {_mm_min_ps(a.v, b.v)}; }
+
+inline simd_float::mask operator<(simd_float a, simd_float b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline simd_float::mask operator<=(simd_float a, simd_float b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline simd_float::mask operator&(simd_float::mask a, simd_float::mask b) { return {_mm_and_ps(a.m, b.m)}; }
+inline simd_float::mask operator|(simd_float::mask a, simd_float::mask b) { return {_mm_or_ps(a.m, b.m)}; }
+
+inline simd_float simd_select(simd_float::mask m, simd_float a, simd_float b) {
+    return {_mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v))};
+}
+inline bool simd_any(simd_float::mask m) { return _mm_movemask_ps(m.m) != 0; }
+
+#else
+
+struct simd_double {
+    static constexpr int width = 1;
+    static constexpr const char* isa = "scalar";
+    double v;
+
+    struct mask { bool m; };
+
+    static simd_double load(const double* p) { return {*p}; }
+    static simd_double broadcast(double x) { return {x}; }
+    void store(double* p) const { *p = v; }
+};
+
+inline simd_double operator+(simd_double a, simd_double b) { return {a.v + b.v}; }
+inline simd_double operator-(simd_double a, simd_double b) { return {a.v - b.v}; }
+inline simd_double operator*(simd_double a, simd_double b) { return {a.v * b.v}; }
+inline simd_double operator/(simd_double a, simd_double b) { return {a.v / b.v}; }
+inline simd_double simd_sqrt(simd_double a) { return {std::sqrt(a.v)}; }
+inline simd_double simd_max(simd_double a, simd_double b) { return {a.v > b.v ? a.v : b.v}; }
+inline simd_double simd_min(simd_double a, simd_double b) { return {a.v < b.v ? a.v : b.v}; }
+
+inline simd_double::mask operator<(simd_double a, simd_double b) { return {a.v < b.v}; }
+inline simd_double::mask operator<=(simd_double a, simd_double b) { return {a.v <= b.v}; }
+inline simd_double::mask operator&(simd_double::mask a, simd_double::mask b) { return {a.m && b.m}; }
+inline simd_double::mask operator|(simd_double::mask a, simd_double::mask b) { return {a.m || b.m}; }
+
+inline simd_double simd_select(simd_double::mask m, simd_double a, simd_double b) { return m.m ? a : b; }
+inline bool simd_any(simd_double::mask m) { return m.m; }
+
+struct simd_float {
+    static constexpr int width = 1;
+    static constexpr const char* isa = "scalar";
+    float v;
+
+    struct mask { bool m; };
+
+    static simd_float load(const float* p) { return {*p}; }
+    static simd_float broadcast(float x) { return {x}; }
+    void store(float* p) const { *p = v; }
+};
+
+inline simd_float operator+(simd_float a, simd_float b) { return {a.v + b.v}; }
+inline simd_float operator-(simd_float a, simd_float b) { return {a.v - b.v}; }
+inline simd_float operator*(simd_float a, simd_float b) { return {a.v * b.v}; }
+inline simd_float operator/(simd_float a, simd_float b) { return {a.v / b.v}; }
+inline simd_float simd_sqrt(simd_float a) { return {std::sqrt(a.v)}; }
+inline simd_float simd_max(simd_float a, simd_float b) { return {a.v > b.v ? a.v : b.v}; }
+inline simd_float simd_min(simd_float a, simd_float b) { return {a.v < b.v ? a.v : b.v}; }
+
+inline simd_float::mask operator<(simd_float a, simd_float b) { return {a.v < b.v}; }
+inline simd_float::mask operator<=(simd_float a, simd_float b) { return {a.v <= b.v}; }
+inline simd_float::mask operator&(simd_float::mask a, simd_float::mask b) { return {a.m && b.m}; }
+inline simd_float::mask operator|(simd_float::mask a, simd_float::mask b) { return {a.m || b.m}; }
+
+inline simd_float simd_select(simd_float::mask m, simd_float a, simd_float b) { return m.m ? a : b; }
+inline bool simd_any(simd_float::mask m) { return m.m; }
+
+#endif
+
+// vector type matching a scalar type.
+template <typename T>
+using simd_of = std::conditional_t<std::is_same_v<T, float>, simd_float, simd_double>;
+
+#endif
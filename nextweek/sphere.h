@@ -3,24 +3,34 @@
 
 #include "hittable.h"
 
-class sphere : public hittable {
+class sphere_shape {
+    // the sphere geometry itself, without a vtable. closed_scene stores these by value,
+    // sphere wraps one to make it a hittable.
 
-    private:
+    public:
         point3 center;
-        double radius;
-        shared_ptr<material> mat;
+        real radius;
+        const material* mat; // owned by the scene's material_table.
 
-    public:
-        sphere(const point3& center_, double radius_, shared_ptr<material> mat_): center(center_),
+        sphere_shape(const point3& center_, real radius_, const material* mat_): center(center_),
                 radius(std::fmax(0,radius_)), mat(mat_){}
 
-        bool hit(const ray& r, interval ray_t, hit_record &rec) const override {
+        bool hit(const ray& r, interval ray_t, hit_record &rec) const {
+            RT_STAT_SPHERE_TESTS(1);
             vec3 oc = (center - r.origin());
             auto a = r.direction().length_squared();
             auto h = dot(r.direction(), oc);
-            auto c = oc.length_squared() - radius*radius;
 
-            auto discriminant = h*h - a*c;
+            real discriminant;
+            if constexpr (robust_geometry) {
+                // h*h - a*c cancels badly in float. a*(r^2 - |l|^2), with l the vector from the
+                // center to the ray's closest approach, is the same value without the cancellation.
+                vec3 l = (h/a)*r.direction() - oc;
+                discriminant = a*(radius*radius - l.length_squared());
+            } else {
+                auto c = oc.length_squared() - radius*radius;
+                discriminant = h*h - a*c;
+            }
             if (discriminant < 0) return false;
 
             auto sqrtd = std::sqrt(discriminant);
@@ -41,6 +51,28 @@ class sphere : public hittable {
             
             return true;
         }
+
+        aabb bounding_box() const {
+            auto rvec = vec3(radius, radius, radius);
+            return aabb(center - rvec, center + rvec);
+        }
+};
+
+class sphere : public hittable {
+
+    private:
+        sphere_shape shape;
+        aabb bbox;
+
+    public:
+        sphere(const point3& center_, real radius_, const material* mat_)
+            : shape(center_, radius_, mat_), bbox(shape.bounding_box()) {}
+
+        bool hit(const ray& r, interval ray_t, hit_record &rec) const override {
+            return shape.hit(r, ray_t, rec);
+        }
+
+        aabb bounding_box() const override { return bbox; }
 };
 
-#endif
\ No newline at end of file
+#endif
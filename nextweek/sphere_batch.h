@@ -0,0 +1,160 @@
+#ifndef SPHERE_BATCH_H
+#define SPHERE_BATCH_H
+
+/*
+    A flat collection of spheres intersected together.
+
+    Centers and radii are kept as separate arrays (structure of arrays), so
+    one vector load fetches the same field of simd_of<real>::width spheres
+    and the ray is tested against all of them at once. Only the index of
+    the closest sphere is tracked in the loop; the hit record (and the
+    material lookup) is filled in once at the end.
+
+    The arrays are padded up to a multiple of the vector width with NaN
+    centers. Every comparison against NaN is false, so padding lanes never
+    report a hit and the kernel needs no tail loop.
+*/
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "simd.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class sphere_batch : public hittable {
+    public:
+        sphere_batch() {}
+
+        void add(const point3& center, real radius, const material* mat) {
+            if (count % simd_of<real>::width == 0) {
+                // start a new block of lanes, filled with padding.
+                auto nan = std::numeric_limits<real>::quiet_NaN();
+                for (int k = 0; k < simd_of<real>::width; k++) {
+                    center_x.push_back(nan);
+                    center_y.push_back(nan);
+                    center_z.push_back(nan);
+                    radii.push_back(0);
+                    mat_index.push_back(0);
+                }
+            }
+
+            radius = std::fmax(real(0), radius);
+            center_x[count] = center.x();
+            center_y[count] = center.y();
+            center_z[count] = center.z();
+            radii[count] = radius;
+            mat_index[count] = material_slot(mat);
+            count++;
+
+            auto rvec = vec3(radius, radius, radius);
+            bbox = aabb(bbox, aabb(center - rvec, center + rvec));
+        }
+
+        size_t size() const { return count; }
+
+        bool hit(const ray& r, interval ray_t, hit_record& rec) const override {
+            using vd = simd_of<real>;
+            constexpr int width = vd::width;
+            RT_STAT_SPHERE_TESTS(count);
+
+            const auto origin_x = vd::broadcast(r.origin().x());
+            const auto origin_y = vd::broadcast(r.origin().y());
+            const auto origin_z = vd::broadcast(r.origin().z());
+            const auto dir_x = vd::broadcast(r.direction().x());
+            const auto dir_y = vd::broadcast(r.direction().y());
+            const auto dir_z = vd::broadcast(r.direction().z());
+            const auto a = vd::broadcast(r.direction().length_squared());
+            const auto t_min = vd::broadcast(ray_t.min);
+            const auto zero = vd::broadcast(0);
+
+            // per lane: distance of the closest sphere seen in that lane, and the block it was in.
+            // blocks rather than sphere indices are tracked, so float lanes stay exact up to 2^24 blocks.
+            auto best_t = vd::broadcast(ray_t.max);
+            auto best_block = vd::broadcast(-1);
+            auto block = vd::broadcast(0);
+            const auto one = vd::broadcast(1);
+
+            for (size_t base = 0; base < radii.size(); base += width, block = block + one) {
+                // same math as sphere::hit, on width spheres at once.
+                auto oc_x = vd::load(&center_x[base]) - origin_x;
+                auto oc_y = vd::load(&center_y[base]) - origin_y;
+                auto oc_z = vd::load(&center_z[base]) - origin_z;
+                auto rad = vd::load(&radii[base]);
+
+                auto h = dir_x*oc_x + dir_y*oc_y + dir_z*oc_z;
+                vd discriminant;
+                if constexpr (robust_geometry) {
+                    // the cancellation free form from sphere_shape::hit.
+                    auto k = h / a;
+                    auto l_x = k*dir_x - oc_x;
+                    auto l_y = k*dir_y - oc_y;
+                    auto l_z = k*dir_z - oc_z;
+                    discriminant = a * (rad*rad - (l_x*l_x + l_y*l_y + l_z*l_z));
+                } else {
+                    auto c = (oc_x*oc_x + oc_y*oc_y + oc_z*oc_z) - rad*rad;
+                    discriminant = h*h - a*c;
+                }
+
+                auto real_roots = zero <= discriminant;
+                if (!simd_any(real_roots)) continue;
+
+                auto sqrtd = simd_sqrt(simd_max(discriminant, zero));
+                auto near_root = (h - sqrtd) / a;
+                auto far_root = (h + sqrtd) / a;
+
+                auto near_ok = real_roots & (t_min < near_root) & (near_root < best_t);
+                auto far_ok = real_roots & (t_min < far_root) & (far_root < best_t);
+                auto hit_lane = near_ok | far_ok;
+
+                auto root = simd_select(near_ok, near_root, far_root);
+                best_t = simd_select(hit_lane, root, best_t);
+                best_block = simd_select(hit_lane, block, best_block);
+            }
+
+            // reduce the lanes down to the single closest sphere.
+            real lane_t[width], lane_block[width];
+            best_t.store(lane_t);
+            best_block.store(lane_block);
+
+            long closest = -1;
+            real closest_t = ray_t.max;
+            for (int k = 0; k < width; k++) {
+                if (lane_block[k] >= 0 && lane_t[k] < closest_t) {
+                    closest_t = lane_t[k];
+                    closest = long(lane_block[k])*width + k;
+                }
+            }
+            if (closest < 0) return false;
+
+            point3 center(center_x[closest], center_y[closest], center_z[closest]);
+            rec.t = closest_t;
+            rec.p = r.at(closest_t);
+            vec3 outward_normal = (rec.p - center) / radii[closest];
+            rec.set_face_normal(r, outward_normal);
+            rec.mat = materials[mat_index[closest]];
+
+            return true;
+        }
+
+        aabb bounding_box() const override { return bbox; }
+
+    private:
+        std::vector<real> center_x, center_y, center_z, radii;
+        std::vector<std::uint32_t> mat_index; // index into materials.
+        size_t count = 0; // spheres stored, the arrays hold count rounded up to the vector width.
+
+        std::vector<const material*> materials; // every distinct material used by the batch, not owned.
+        std::unordered_map<const material*, std::uint32_t> material_slots;
+
+        aabb bbox;
+
+        std::uint32_t material_slot(const material* mat) {
+            auto [it, inserted] = material_slots.try_emplace(mat, std::uint32_t(materials.size()));
+            if (inserted) materials.push_back(mat);
+            return it->second;
+        }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+    Render statistics, compiled in with RT_STATS.
+
+    Counters and histograms are kept per thread, so counting is a plain
+    increment on thread local memory with no atomics or locks. A thread
+    adds its counts to the process totals when it exits (render threads
+    exit at the end of every tile_scheduler::run), and the camera adds the
+    calling thread's and reports the totals at the end of a render.
+
+    Code counts through the RT_STAT_* macros. Without RT_STATS they expand
+    to nothing, so a normal build has no trace of the counters.
+
+        counters:   rays cast, camera rays, sphere and triangle tests, bvh
+                    nodes visited, and what the materials did with the rays
+                    they got.
+        histograms: path depth (rays traced per camera sample) and sphere
+                    tests per ray, one bucket per value, the last bucket
+                    holding everything from there on.
+*/
+
+#ifdef RT_STATS
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace rt_stats {
+
+    enum counter {
+        rays,                   // world hit calls.
+        camera_rays,            // samples, every path starts with one.
+        sphere_tests,
+        triangle_tests,
+        bvh_nodes,              // nodes whose bounding box a ray was tested against.
+        sky_hits,               // rays that escaped the scene.
+        lambertian_scatters,
+        metal_reflections,
+        metal_absorptions,      // fuzzed below the surface.
+        dielectric_reflections,
+        dielectric_refractions,
+        roulette_terminations,
+        depth_limit_terminations,
+        counter_count
+    };
+
+    enum histogram { path_depth, tests_per_ray, histogram_count };
+
+    constexpr int histogram_buckets = 64;
+
+    inline const char* counter_name(int c) {
+        static const char* names[counter_count] = {
+            "rays", "camera_rays", "sphere_tests", "triangle_tests", "bvh_nodes", "sky_hits",
+            "lambertian_scatters", "metal_reflections", "metal_absorptions",
+            "dielectric_reflections", "dielectric_refractions",
+            "roulette_terminations", "depth_limit_terminations"
+        };
+        return names[c];
+    }
+
+    inline const char* histogram_name(int h) {
+        static const char* names[histogram_count] = {"path_depth", "tests_per_ray"};
+        return names[h];
+    }
+
+    struct counts {
+        std::uint64_t counters[counter_count] = {};
+        std::uint64_t histograms[histogram_count][histogram_buckets] = {};
+
+        void add(const counts& other) {
+            for (int c = 0; c < counter_count; c++) counters[c] += other.counters[c];
+            for (int h = 0; h < histogram_count; h++)
+                for (int b = 0; b < histogram_buckets; b++) histograms[h][b] += other.histograms[h][b];
+        }
+
+        void record(histogram h, std::uint64_t value) {
+            histograms[h][value < histogram_buckets ? value : histogram_buckets - 1]++;
+        }
+    };
+
+    struct totals {
+        counts sum;
+        std::mutex lock;
+
+        static totals& get() {
+            static totals instance;
+            return instance;
+        }
+    };
+
+    struct thread_counts : counts {
+        std::uint64_t ray_tests = 0; // sphere tests of the ray being traced.
+
+        void flush() {
+            // hand the counts over to the totals and start again from zero.
+            auto& t = totals::get();
+            {
+                std::lock_guard<std::mutex> guard(t.lock);
+                t.sum.add(*this);
+            }
+            static_cast<counts&>(*this) = counts();
+        }
+
+        ~thread_counts() { flush(); }
+    };
+
+    inline thread_counts& local() {
+        thread_local thread_counts instance;
+        return instance;
+    }
+
+    inline counts take() {
+        // everything counted since the last take, including the calling thread's counts.
+        local().flush();
+        auto& t = totals::get();
+        std::lock_guard<std::mutex> guard(t.lock);
+        counts result = t.sum;
+        t.sum = counts();
+        return result;
+    }
+
+    inline void end_ray() {
+        auto& l = local();
+        l.record(tests_per_ray, l.ray_tests);
+        l.ray_tests = 0;
+    }
+
+    inline void print(std::ostream& out, const counts& c) {
+        auto n = [&](counter k) { return double(c.counters[k]); };
+        auto per = [](double a, double b) { return b > 0 ? a / b : 0.0; };
+        char line[256];
+
+        out << "Render statistics:\n";
+        std::snprintf(line, sizeof(line), "  rays                %14.0f  %.2f per camera ray\n",
+            n(rays), per(n(rays), n(camera_rays)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  sphere tests        %14.0f  %.2f per ray\n",
+            n(sphere_tests), per(n(sphere_tests), n(rays)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  triangle tests      %14.0f  %.2f per ray\n",
+            n(triangle_tests), per(n(triangle_tests), n(rays)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  bvh nodes visited   %14.0f  %.2f per ray\n",
+            n(bvh_nodes), per(n(bvh_nodes), n(rays)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  escaped to sky      %14.0f  %.1f%% of rays\n",
+            n(sky_hits), 100 * per(n(sky_hits), n(rays)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  lambertian          %14.0f scatters\n", n(lambertian_scatters));
+        out << line;
+        std::snprintf(line, sizeof(line), "  metal               %14.0f reflections, %.0f absorbed (%.1f%%)\n",
+            n(metal_reflections), n(metal_absorptions),
+            100 * per(n(metal_absorptions), n(metal_reflections) + n(metal_absorptions)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  dielectric          %14.0f refractions, %.0f reflections (%.1f%%)\n",
+            n(dielectric_refractions), n(dielectric_reflections),
+            100 * per(n(dielectric_reflections), n(dielectric_refractions) + n(dielectric_reflections)));
+        out << line;
+        std::snprintf(line, sizeof(line), "  paths cut           %14.0f by russian roulette, %.0f at max depth\n",
+            n(roulette_terminations), n(depth_limit_terminations));
+        out << line;
+
+        for (int h = 0; h < histogram_count; h++) {
+            // mean, then the share of each value down to where the rest adds up to under 0.1%.
+            double total = 0, weighted = 0;
+            for (int b = 0; b < histogram_buckets; b++) {
+                total += double(c.histograms[h][b]);
+                weighted += double(c.histograms[h][b]) * b;
+            }
+            std::snprintf(line, sizeof(line), "  %-19s mean %.2f:", histogram_name(h), per(weighted, total));
+            out << line;
+            double shown = 0;
+            for (int b = 0; b < histogram_buckets && total - shown > 0.001 * total; b++) {
+                shown += double(c.histograms[h][b]);
+                if (c.histograms[h][b] == 0) continue;
+                std::snprintf(line, sizeof(line), " %d%s:%.1f%%", b, b == histogram_buckets - 1 ? "+" : "",
+                    100 * double(c.histograms[h][b]) / total);
+                out << line;
+            }
+            out << '\n';
+        }
+    }
+
+    inline void write_json(std::ostream& out, const counts& c) {
+        out << "{\n  \"counters\": {\n";
+        for (int k = 0; k < counter_count; k++)
+            out << "    \"" << counter_name(k) << "\": " << c.counters[k] << (k + 1 < counter_count ? ",\n" : "\n");
+        out << "  },\n  \"histograms\": {\n";
+        for (int h = 0; h < histogram_count; h++) {
+            out << "    \"" << histogram_name(h) << "\": [";
+            for (int b = 0; b < histogram_buckets; b++) out << (b ? ", " : "") << c.histograms[h][b];
+            out << (h + 1 < histogram_count ? "],\n" : "]\n");
+        }
+        out << "  }\n}\n";
+    }
+}
+
+#define RT_STAT_COUNT(name) (rt_stats::local().counters[rt_stats::name]++)
+#define RT_STAT_RECORD(hist, value) (rt_stats::local().record(rt_stats::hist, std::uint64_t(value)))
+#define RT_STAT_SPHERE_TESTS(n) \
+    do { auto& rt_stat_l = rt_stats::local(); rt_stat_l.counters[rt_stats::sphere_tests] += (n); rt_stat_l.ray_tests += (n); } while (0)
+#define RT_STAT_END_RAY() (rt_stats::end_ray())
+
+#else
+
+#define RT_STAT_COUNT(name) ((void)0)
+#define RT_STAT_RECORD(hist, value) ((void)0)
+#define RT_STAT_SPHERE_TESTS(n) ((void)0)
+#define RT_STAT_END_RAY() ((void)0)
+
+#endif
+
+#endif
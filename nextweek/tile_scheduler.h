@@ -0,0 +1,118 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+/*
+    Parallel scheduling of image tiles.
+
+    The image is cut into rectangular tiles which are dealt out to one
+    queue per worker thread. A worker drains its own queue from the front
+    and, once it runs dry, steals from the back of the other queues, so
+    threads that got cheap tiles (sky) help out the ones stuck with
+    expensive tiles (glass, deep paths) until every tile is done.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct tile {
+    int x0, y0; // top left pixel of the tile (inclusive).
+    int x1, y1; // bottom right pixel of the tile (exclusive).
+};
+
+inline std::vector<tile> make_tiles(int width, int height, int tile_size) {
+    // cut a width x height image into tiles in scanline order.
+    tile_size = std::max(tile_size, 1);
+    std::vector<tile> tiles;
+    for (int y = 0; y < height; y += tile_size)
+        for (int x = 0; x < width; x += tile_size)
+            tiles.push_back({x, y, std::min(x + tile_size, width), std::min(y + tile_size, height)});
+    return tiles;
+}
+
+class tile_queue {
+    private:
+        std::deque<tile> tiles;
+        std::mutex lock;
+
+    public:
+        void push(const tile& t) {
+            std::lock_guard<std::mutex> guard(lock);
+            tiles.push_back(t);
+        }
+
+        bool pop(tile& t) {
+            // owner takes work from the front, in the order it was dealt.
+            std::lock_guard<std::mutex> guard(lock);
+            if (tiles.empty()) return false;
+            t = tiles.front();
+            tiles.pop_front();
+            return true;
+        }
+
+        bool steal(tile& t) {
+            // thieves take from the back, away from where the owner is working.
+            std::lock_guard<std::mutex> guard(lock);
+            if (tiles.empty()) return false;
+            t = tiles.back();
+            tiles.pop_back();
+            return true;
+        }
+};
+
+class tile_scheduler {
+    private:
+        int num_threads;
+
+    public:
+        // a thread count of 0 or less uses every hardware thread.
+        tile_scheduler(int num_threads_) : num_threads(num_threads_) {
+            if (num_threads <= 0) num_threads = int(std::max(1u, std::thread::hardware_concurrency()));
+        }
+
+        int thread_count() const { return num_threads; }
+
+        /*
+            calls render_tile(tile, thread_index) once for every tile, spread over
+            all worker threads, and returns when every tile has been rendered.
+            the calling thread works as thread 0.
+        */
+        template <typename F>
+        void run(const std::vector<tile>& tiles, F&& render_tile) const {
+            int workers = std::max(1, std::min(num_threads, int(tiles.size())));
+
+            // deal tiles out in contiguous runs so neighbouring tiles stay on one thread.
+            std::vector<tile_queue> queues(workers);
+            size_t per_worker = (tiles.size() + workers - 1) / workers;
+            for (size_t i = 0; i < tiles.size(); i++)
+                queues[i / per_worker].push(tiles[i]);
+
+            auto work = [&](int id) {
+                tile t;
+                while (true) {
+                    if (queues[id].pop(t)) {
+                        render_tile(t, id);
+                        continue;
+                    }
+
+                    // own queue is empty, go looking for work elsewhere.
+                    bool stolen = false;
+                    for (int k = 1; k < workers && !stolen; k++)
+                        stolen = queues[(id + k) % workers].steal(t);
+                    if (!stolen) return; // tiles are never added back, so everything is taken.
+                    render_tile(t, id);
+                }
+            };
+
+            std::vector<std::thread> threads;
+            for (int id = 1; id < workers; id++)
+                threads.emplace_back(work, id);
+            work(0);
+            for (auto& th : threads) th.join();
+        }
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+    Timeline of a render, written as Chrome trace event JSON.
+
+    The file opens in chrome://tracing or ui.perfetto.dev, with one track
+    per render thread showing every tile it rendered, a track for the
+    camera's stages (frame, passes, bands, denoising, output) and one for
+    the streaming writer thread. Gaps on a render track are time that
+    thread sat idle, waiting for the rest to finish their tiles.
+
+    Every track has its own event list, and a track is only ever written
+    by one thread at a time (render thread k is worker k of the scheduler),
+    so recording takes no locks. A recorder that hasn't been started
+    ignores everything, so with tracing off a tile costs two more
+    branches.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+class trace_recorder {
+    public:
+        struct event {
+            const char* name;
+            const char* category;
+            double start_us, end_us; // since the recorder was started.
+            const char* arg_names[4]; // what the event was about: tile rectangle, pass number.
+            int args[4];
+            int arg_count;
+        };
+
+        using args = std::initializer_list<std::pair<const char*, int>>;
+
+        bool active() const { return started; }
+
+        void start(int render_threads) {
+            // one track per render thread, then the camera's stages and the writer thread.
+            started = true;
+            workers = render_threads;
+            tracks.assign(size_t(render_threads) + 2, {});
+            origin = std::chrono::steady_clock::now();
+        }
+
+        int stage_track() const { return workers; }
+        int writer_track() const { return workers + 1; }
+
+        double now() const {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+        }
+
+        static event make_event(const char* name, const char* category, args event_args) {
+            event e{name, category, 0, 0, {}, {}, 0};
+            for (const auto& [arg_name, value] : event_args) {
+                if (e.arg_count == 4) break;
+                e.arg_names[e.arg_count] = arg_name;
+                e.args[e.arg_count++] = value;
+            }
+            return e;
+        }
+
+        void add(int track, const event& e) {
+            if (started) tracks[track].push_back(e);
+        }
+
+        void add(int track, const char* name, const char* category, double start_us, double end_us,
+                args event_args = {}) {
+            if (!started) return;
+            event e = make_event(name, category, event_args);
+            e.start_us = start_us;
+            e.end_us = end_us;
+            tracks[track].push_back(e);
+        }
+
+        bool finish(const std::string& path) {
+            // writes the trace to path and stops recording.
+            started = false;
+            std::ofstream out(path);
+            if (!out) return false;
+
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            bool first = true;
+            char line[320];
+            for (size_t t = 0; t < tracks.size(); t++) {
+                std::string track_name = int(t) < workers ? "render thread " + std::to_string(t)
+                                       : int(t) == workers ? "camera" : "writer";
+                std::snprintf(line, sizeof(line),
+                    "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", t, track_name.c_str());
+                out << line;
+                first = false;
+
+                for (const auto& e : tracks[t]) {
+                    std::snprintf(line, sizeof(line),
+                        ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %zu, "
+                        "\"ts\": %.3f, \"dur\": %.3f, \"args\": {",
+                        e.name, e.category, t, e.start_us, e.end_us - e.start_us);
+                    out << line;
+                    for (int a = 0; a < e.arg_count; a++)
+                        out << (a ? ", " : "") << '"' << e.arg_names[a] << "\": " << e.args[a];
+                    out << "}}";
+                }
+            }
+            out << "\n]}\n";
+            tracks.clear();
+            return bool(out);
+        }
+
+    private:
+        bool started = false;
+        int workers = 0;
+        std::vector<std::vector<event>> tracks;
+        std::chrono::steady_clock::time_point origin;
+};
+
+class trace_span {
+    // records an event on a track from construction to destruction.
+    public:
+        trace_span(trace_recorder& trace_, int track_, const char* name, const char* category,
+                trace_recorder::args event_args = {})
+            : trace(trace_), track(track_), e(trace_recorder::make_event(name, category, event_args)) {
+            if (trace.active()) e.start_us = trace.now();
+        }
+
+        ~trace_span() {
+            if (!trace.active()) return;
+            e.end_us = trace.now();
+            trace.add(track, e);
+        }
+
+    private:
+        trace_recorder& trace;
+        int track;
+        trace_recorder::event e;
+};
+
+#endif
@@ -1,50 +1,57 @@
 #ifndef VEC3_H
 #define VEC3_H
 
+#include <type_traits>
 
-class vec3 {
+// scalar arguments of the operators below don't take part in deduction, so mixing
+// a double literal with a float vector (0.5 * v) still picks the vector's type.
+template <typename T>
+using scalar_of = std::type_identity_t<T>;
+
+template <typename T>
+class vec3_t {
 
 public:
-    double e[3];
+    T e[3];
 
-    vec3() : e{0,0,0} {}
-    vec3(double e0, double e1, double e2) : e{e0,e1,e2}{}
+    vec3_t() : e{0,0,0} {}
+    vec3_t(T e0, T e1, T e2) : e{e0,e1,e2}{}
 
-    double x() const {return e[0];}
-    double y() const {return e[1];}
-    double z() const {return e[2];}
+    T x() const {return e[0];}
+    T y() const {return e[1];}
+    T z() const {return e[2];}
 
-    vec3& operator+=(const vec3& v) {
+    vec3_t& operator+=(const vec3_t& v) {
         e[0] += v.e[0];
         e[1] += v.e[1];
         e[2] += v.e[2];
         return *this;
     }
 
-    vec3 operator-() const {return vec3(-e[0], -e[1], -e[2]); }
+    vec3_t operator-() const {return vec3_t(-e[0], -e[1], -e[2]); }
 
-    double operator[](int i) const {return e[i];}
-    double& operator[](int i) {return e[i];}
-    vec3& operator*=(double t) {
+    T operator[](int i) const {return e[i];}
+    T& operator[](int i) {return e[i];}
+    vec3_t& operator*=(T t) {
         e[0] *= t;
         e[1] *= t;
         e[2] *= t;
         return *this;
     }
 
-    double length() const {return std::sqrt(length_squared());}
+    T length() const {return std::sqrt(length_squared());}
 
-    double length_squared() const {
+    T length_squared() const {
         return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
     }
 
     // generate random vectors. 
-    static vec3 random() {
-        return vec3(random_double(), random_double(), random_double());
+    static vec3_t random() {
+        return vec3_t(random_double(), random_double(), random_double());
     }
 
-    static vec3 random(double min, double max) {
-        return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+    static vec3_t random(double min, double max) {
+        return vec3_t(random_double(min, max), random_double(min, max), random_double(min, max));
     }
 
     bool near_zero() const {
@@ -54,65 +61,81 @@ public:
     }
 };
 
+// explicit SIMD versions of vec3_t<double> / vec3_t<float>, chosen at build time.
+#if defined(RT_SIMD_VEC3)
+#include "vec3_simd.h"
+#endif
+
+using vec3 = vec3_t<real>;
 using point3 = vec3;
 
 
 // Vector Utility Functions
 
-inline std::ostream& operator<<(std::ostream& out, const vec3& v) {
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const vec3_t<T>& v) {
     return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
 }
 
-inline vec3 operator+(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+template <typename T>
+inline vec3_t<T> operator+(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
 }
 
-inline vec3 operator-(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+template <typename T>
+inline vec3_t<T> operator-(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
 }
 
-inline vec3 operator*(const vec3& u, const vec3& v) {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+template <typename T>
+inline vec3_t<T> operator*(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-inline vec3 operator*(double t, const vec3& v) {
-    return vec3(t*v.e[0], t*v.e[1], t*v.e[2]);
+template <typename T>
+inline vec3_t<T> operator*(scalar_of<T> t, const vec3_t<T>& v) {
+    return vec3_t<T>(t*v.e[0], t*v.e[1], t*v.e[2]);
 }
 
-inline vec3 operator*(const vec3& v, double t) {
+template <typename T>
+inline vec3_t<T> operator*(const vec3_t<T>& v, scalar_of<T> t) {
     return t * v;
 }
 
-inline vec3 operator/(const vec3& v, double t) {
+template <typename T>
+inline vec3_t<T> operator/(const vec3_t<T>& v, scalar_of<T> t) {
     return (1/t) * v;
 }
 
 
-inline double dot(const vec3& u, const vec3& v) {
+template <typename T>
+inline T dot(const vec3_t<T>& u, const vec3_t<T>& v) {
     return u.e[0] * v.e[0]
          + u.e[1] * v.e[1]
          + u.e[2] * v.e[2];
 }
 
-inline vec3 cross(const vec3& u, const vec3& v) {
-    return vec3(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+template <typename T>
+inline vec3_t<T> cross(const vec3_t<T>& u, const vec3_t<T>& v) {
+    return vec3_t<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
                 u.e[2] * v.e[0] - u.e[0] * v.e[2],
                 u.e[0] * v.e[1] - u.e[1] * v.e[0]);
 }
 
-inline vec3 unit_vector(const vec3& v) {
+template <typename T>
+inline vec3_t<T> unit_vector(const vec3_t<T>& v) {
     return v / v.length();
 }
 
 
 inline vec3 random_unit_vector() {
-    // find a random vector inside the sphere.
-    while (true) {
-        auto p = vec3::random(-1,1);
-        auto lensq = p.length_squared();
-        // 
-        if (1e-160 < lensq && lensq <= 1) return p/sqrt(lensq);
-    }
+    /* uniform direction from exactly two random numbers: z uniform in [-1,1] and a
+       uniform angle around the z axis. a rejection loop would use a varying number
+       of them, which breaks the stratification of the low discrepancy samplers. */
+    auto z = 1 - 2*random_double();
+    auto phi = 2*pi*random_double();
+    auto r = std::sqrt(std::fmax(0.0, 1 - z*z));
+    return vec3(r*std::cos(phi), r*std::sin(phi), z);
 }
 
 inline vec3 random_on_hemisphere(const vec3& normal) {
@@ -127,7 +150,8 @@ inline vec3 random_on_hemisphere(const vec3& normal) {
     else return -on_unit_hemisphere;
 }
 
-inline vec3 reflect(const vec3& v, const vec3& n) {
+template <typename T>
+inline vec3_t<T> reflect(const vec3_t<T>& v, const vec3_t<T>& n) {
     /* For the polished materials, the reflected ray is not randomly
      * scattered. The reflected ray direction is just v+2b. From the
      * book, 'n' is a unit normal to the surface. To get the vector
@@ -141,21 +165,32 @@ inline vec3 reflect(const vec3& v, const vec3& n) {
     return v- 2*dot(v,n)*n; 
 }
 
-inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat) {
+template <typename T>
+inline vec3_t<T> refract(const vec3_t<T>& uv, const vec3_t<T>& n, scalar_of<T> etai_over_etat) {
     // returns the refracted ray for the given uv ray when passing through a medium
     // with refractive index 'etai_over_etat'.
-    auto cos_theta = std::fmin(dot(-uv, n), 1.0);
-    vec3 r_out_perp = etai_over_etat * (uv + cos_theta*n);
-    vec3 r_out_parallel = -std::sqrt(std::fabs(1.0 - r_out_perp.length_squared()))*n;
+    auto cos_theta = std::fmin(dot(-uv, n), T(1.0));
+    vec3_t<T> r_out_perp = etai_over_etat * (uv + cos_theta*n);
+    vec3_t<T> r_out_parallel = -std::sqrt(std::fabs(T(1.0) - r_out_perp.length_squared()))*n;
     return r_out_perp + r_out_parallel;
 }
 
 inline vec3 random_in_unit_disk() {
-    while (true) {
-        auto p = vec3(random_double(-1,1), random_double(-1,1),0);
-        if (p.length_squared() < 1)
-            return p;
+    // concentric mapping of the square onto the disk (Shirley and Chiu), which keeps
+    // stratified points stratified and, like random_unit_vector, uses two numbers.
+    auto a = random_double(-1,1);
+    auto b = random_double(-1,1);
+    if (a == 0 && b == 0) return vec3(0,0,0);
+
+    double r, theta;
+    if (std::fabs(a) > std::fabs(b)) {
+        r = a;
+        theta = (pi/4) * (b/a);
+    } else {
+        r = b;
+        theta = pi/2 - (pi/4) * (a/b);
     }
+    return vec3(r*std::cos(theta), r*std::sin(theta), 0);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,227 @@
+#ifndef VEC3_SIMD_H
+#define VEC3_SIMD_H
+
+/*
+    SIMD specializations of vec3_t, enabled with RT_SIMD_VEC3.
+
+    The three components are padded to four lanes and kept in one vector
+    register: __m256d (AVX) for double, __m128 (SSE2) for float. The
+    operators below are plain (non-template) overloads, so they win over
+    the generic templates in vec3.h, and every call site stays unchanged.
+    Without AVX there is no double specialization to fall back to quietly,
+    so the build stops instead: configure with RT_NATIVE on an AVX machine.
+
+    Each lane does the same IEEE operation the scalar code does, and dot()
+    adds the products in the same (x + y) + z order, so results match the
+    scalar vec3_t bit for bit. The padding lane is never read back.
+
+    Included from vec3.h, after the primary template.
+*/
+
+#include <immintrin.h>
+
+#if !defined(__AVX__)
+#error "RT_SIMD_VEC3 needs AVX for the double vec3 (configure with -DRT_NATIVE=ON on an AVX machine)"
+#endif
+
+template <>
+class alignas(32) vec3_t<double> {
+
+public:
+    __m256d v; // x, y, z and a padding lane.
+
+    vec3_t() : v{_mm256_setzero_pd()} {}
+    vec3_t(double e0, double e1, double e2) : v{_mm256_set_pd(0, e2, e1, e0)} {}
+    explicit vec3_t(__m256d v_) : v{v_} {}
+
+    double x() const {return _mm256_cvtsd_f64(v);}
+    double y() const {return _mm_cvtsd_f64(_mm_unpackhi_pd(_mm256_castpd256_pd128(v), _mm256_castpd256_pd128(v)));}
+    double z() const {return _mm_cvtsd_f64(_mm256_extractf128_pd(v, 1));}
+
+    vec3_t& operator+=(const vec3_t& u) {
+        v = _mm256_add_pd(v, u.v);
+        return *this;
+    }
+
+    vec3_t operator-() const {return vec3_t(_mm256_xor_pd(v, _mm256_set1_pd(-0.0)));}
+
+    double operator[](int i) const {
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, v);
+        return lanes[i];
+    }
+
+    vec3_t& operator*=(double t) {
+        v = _mm256_mul_pd(v, _mm256_set1_pd(t));
+        return *this;
+    }
+
+    double length() const {return std::sqrt(length_squared());}
+
+    double length_squared() const;
+
+    static vec3_t random() {
+        return vec3_t(random_double(), random_double(), random_double());
+    }
+
+    static vec3_t random(double min, double max) {
+        return vec3_t(random_double(min, max), random_double(min, max), random_double(min, max));
+    }
+
+    bool near_zero() const {
+        auto abs = _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+        auto small = _mm256_cmp_pd(abs, _mm256_set1_pd(1e-8), _CMP_LT_OQ);
+        return (_mm256_movemask_pd(small) & 0x7) == 0x7;
+    }
+};
+
+inline vec3_t<double> operator+(const vec3_t<double>& u, const vec3_t<double>& v) {
+    return vec3_t<double>(_mm256_add_pd(u.v, v.v));
+}
+
+inline vec3_t<double> operator-(const vec3_t<double>& u, const vec3_t<double>& v) {
+    return vec3_t<double>(_mm256_sub_pd(u.v, v.v));
+}
+
+inline vec3_t<double> operator*(const vec3_t<double>& u, const vec3_t<double>& v) {
+    return vec3_t<double>(_mm256_mul_pd(u.v, v.v));
+}
+
+inline vec3_t<double> operator*(double t, const vec3_t<double>& v) {
+    return vec3_t<double>(_mm256_mul_pd(_mm256_set1_pd(t), v.v));
+}
+
+inline vec3_t<double> operator*(const vec3_t<double>& v, double t) {
+    return t * v;
+}
+
+inline vec3_t<double> operator/(const vec3_t<double>& v, double t) {
+    return (1/t) * v;
+}
+
+inline double dot(const vec3_t<double>& u, const vec3_t<double>& v) {
+    __m256d m = _mm256_mul_pd(u.v, v.v);
+    __m128d xy = _mm256_castpd256_pd128(m);
+    __m128d zw = _mm256_extractf128_pd(m, 1);
+    __m128d sum = _mm_add_sd(_mm_add_sd(xy, _mm_unpackhi_pd(xy, xy)), zw);
+    return _mm_cvtsd_f64(sum);
+}
+
+inline double vec3_t<double>::length_squared() const { return dot(*this, *this); }
+
+// (y, z, x, w) and (z, x, y, w) of (x, y, z, w). AVX has no lane permute across the two
+// halves but permute2f128, so both swap the halves first.
+inline __m256d rotate_yzx(__m256d a) {
+    __m256d swapped = _mm256_permute2f128_pd(a, a, 0x01);                   // z w x y
+    return _mm256_permute_pd(_mm256_blend_pd(a, swapped, 0b0101), 0b1001);  // z y x w -> y z x w
+}
+
+inline __m256d rotate_zxy(__m256d a) {
+    __m256d swapped = _mm256_permute2f128_pd(a, a, 0x01);                   // z w x y
+    return _mm256_shuffle_pd(swapped, a, 0b1100);
+}
+
+inline vec3_t<double> cross(const vec3_t<double>& u, const vec3_t<double>& v) {
+    // (u.yzx * v.zxy) - (u.zxy * v.yzx)
+    __m256d u_yzx = rotate_yzx(u.v);
+    __m256d u_zxy = rotate_zxy(u.v);
+    __m256d v_yzx = rotate_yzx(v.v);
+    __m256d v_zxy = rotate_zxy(v.v);
+    return vec3_t<double>(_mm256_sub_pd(_mm256_mul_pd(u_yzx, v_zxy), _mm256_mul_pd(u_zxy, v_yzx)));
+}
+
+
+template <>
+class alignas(16) vec3_t<float> {
+
+public:
+    __m128 v; // x, y, z and a padding lane.
+
+    vec3_t() : v{_mm_setzero_ps()} {}
+    vec3_t(float e0, float e1, float e2) : v{_mm_set_ps(0, e2, e1, e0)} {}
+    explicit vec3_t(__m128 v_) : v{v_} {}
+
+    float x() const {return _mm_cvtss_f32(v);}
+    float y() const {return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1)));}
+    float z() const {return _mm_cvtss_f32(_mm_movehl_ps(v, v));}
+
+    vec3_t& operator+=(const vec3_t& u) {
+        v = _mm_add_ps(v, u.v);
+        return *this;
+    }
+
+    vec3_t operator-() const {return vec3_t(_mm_xor_ps(v, _mm_set1_ps(-0.0f)));}
+
+    float operator[](int i) const {
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, v);
+        return lanes[i];
+    }
+
+    vec3_t& operator*=(float t) {
+        v = _mm_mul_ps(v, _mm_set1_ps(t));
+        return *this;
+    }
+
+    float length() const {return std::sqrt(length_squared());}
+
+    float length_squared() const;
+
+    static vec3_t random() {
+        return vec3_t(random_double(), random_double(), random_double());
+    }
+
+    static vec3_t random(double min, double max) {
+        return vec3_t(random_double(min, max), random_double(min, max), random_double(min, max));
+    }
+
+    bool near_zero() const {
+        auto abs = _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+        auto small = _mm_cmplt_ps(abs, _mm_set1_ps(1e-8f));
+        return (_mm_movemask_ps(small) & 0x7) == 0x7;
+    }
+};
+
+inline vec3_t<float> operator+(const vec3_t<float>& u, const vec3_t<float>& v) {
+    return vec3_t<float>(_mm_add_ps(u.v, v.v));
+}
+
+inline vec3_t<float> operator-(const vec3_t<float>& u, const vec3_t<float>& v) {
+    return vec3_t<float>(_mm_sub_ps(u.v, v.v));
+}
+
+inline vec3_t<float> operator*(const vec3_t<float>& u, const vec3_t<float>& v) {
+    return vec3_t<float>(_mm_mul_ps(u.v, v.v));
+}
+
+inline vec3_t<float> operator*(float t, const vec3_t<float>& v) {
+    return vec3_t<float>(_mm_mul_ps(_mm_set1_ps(t), v.v));
+}
+
+inline vec3_t<float> operator*(const vec3_t<float>& v, float t) {
+    return t * v;
+}
+
+inline vec3_t<float> operator/(const vec3_t<float>& v, float t) {
+    return (1/t) * v;
+}
+
+inline float dot(const vec3_t<float>& u, const vec3_t<float>& v) {
+    __m128 m = _mm_mul_ps(u.v, v.v);
+    __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1,1,1,1));
+    __m128 z = _mm_movehl_ps(m, m);
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+}
+
+inline float vec3_t<float>::length_squared() const { return dot(*this, *this); }
+
+inline vec3_t<float> cross(const vec3_t<float>& u, const vec3_t<float>& v) {
+    // (u.yzx * v.zxy) - (u.zxy * v.yzx)
+    __m128 u_yzx = _mm_shuffle_ps(u.v, u.v, _MM_SHUFFLE(3,0,2,1));
+    __m128 u_zxy = _mm_shuffle_ps(u.v, u.v, _MM_SHUFFLE(3,1,0,2));
+    __m128 v_yzx = _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(3,0,2,1));
+    __m128 v_zxy = _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(3,1,0,2));
+    return vec3_t<float>(_mm_sub_ps(_mm_mul_ps(u_yzx, v_zxy), _mm_mul_ps(u_zxy, v_yzx)));
+}
+
+#endif
@@ -11,6 +11,11 @@
 #include "rtweekend.h"
 #include "hittable.h"
 #include "material.h"
+#include "tile_scheduler.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 class camera {
     public:
@@ -28,35 +33,47 @@ class camera {
         double defocus_angle = 0; // variation angle of rays through each pixel.
         double focus_dist = 10; // distance from camera lookfrom point to plane of perfect focus.
 
+        int num_threads = 0; // render threads, 0 uses every hardware thread.
+        int tile_size = 16; // width and height of the square tiles handed to each thread.
+
         void render(const hittable& world) {
             
             initialize();
 
-            // render code.
-            std::cout << "P3\n" << image_width << " " << image_height << "\n255\n";
+            /* split the image into tiles, render the tiles in parallel into a shared framebuffer,
+               and only write out the image once every tile has finished. */
+
+            std::vector<color> framebuffer(size_t(image_width) * image_height);
+            auto tiles = make_tiles(image_width, image_height, tile_size);
+            tile_scheduler scheduler(num_threads);
 
-            /* iterate over all the pixels in the image, compute color for each ray from camera center to pixel_center in image. */
+            std::atomic<int> tiles_done{0};
+            std::mutex progress_lock;
 
-            for (int j = 0; j < image_height; j++) {
-                std::clog << "\rScanlines remaining: " << (image_height -j) << ' ' << std::flush;
+            scheduler.run(tiles, [&](const tile& t, int) {
+                for (int j = t.y0; j < t.y1; j++) {
+                    for (int i = t.x0; i < t.x1; i++) {
 
-                for (int i = 0;i < image_width; i++){
-                    
-                    // sample some rays around this pixel, and average the colors returned by all samples.
-                    color pixel_color(0,0,0);
-                    for (int sample = 0; sample < samples_per_pixel; sample++){
-                        ray r = get_ray(i,j);
-                        pixel_color += ray_color(r, max_depth, world);
+                        // sample some rays around this pixel, and average the colors returned by all samples.
+                        color pixel_color(0,0,0);
+                        for (int sample = 0; sample < samples_per_pixel; sample++){
+                            ray r = get_ray(i,j);
+                            pixel_color += ray_color(r, max_depth, world);
+                        }
+                        framebuffer[size_t(j)*image_width + i] = pixel_samples_scale * pixel_color;
                     }
+                }
 
-                    // auto pixel_center = pixel00_loc + (i*pixel_delta_u) + (j*pixel_delta_v);
-                    // auto ray_direction = pixel_center - camera_center;
-                    // ray r(camera_center, ray_direction);
+                int remaining = int(tiles.size()) - (++tiles_done);
+                std::lock_guard<std::mutex> guard(progress_lock);
+                std::clog << "\rTiles remaining: " << remaining << ' ' << std::flush;
+            });
+
+            // render code.
+            std::cout << "P3\n" << image_width << " " << image_height << "\n255\n";
+            for (const auto& pixel_color : framebuffer)
+                write_color(std::cout, pixel_color);
 
-                    // color pixel_color = ray_color(r, world); 
-                    write_color(std::cout, pixel_samples_scale* pixel_color);
-                }
-            }
             std::clog << "\rDone.           \n";
 
 
@@ -138,7 +155,7 @@ class camera {
             
         }
 
-        color ray_color (const ray& r, int depth, const hittable& world) {
+        color ray_color (const ray& r, int depth, const hittable& world) const {
 
             if (depth <= 0) return color(0,0,0); // if we've exceeded ray bounce limit, no more light is gathered.
 
@@ -0,0 +1,99 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+/*
+    Random number generation.
+
+    Every thread owns its own xoshiro256++ generator, so drawing a number
+    touches no shared state and needs no locking. The state is 32 bytes
+    and one draw is a handful of shifts, rotates and adds, which matters
+    since random_double() is called for every sample and every iteration
+    of the rejection loops in vec3.h.
+
+    Generators are seeded through splitmix64 from a global seed plus a
+    per-thread stream number, so threads get unrelated sequences.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+inline std::uint64_t splitmix64(std::uint64_t& x) {
+    // used to expand a single 64 bit seed into a full generator state.
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+class xoshiro256pp {
+    private:
+        std::uint64_t s[4];
+
+        static std::uint64_t rotl(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    public:
+        xoshiro256pp(std::uint64_t seed = 0) { reseed(seed); }
+
+        void reseed(std::uint64_t seed) {
+            for (auto& word : s) word = splitmix64(seed);
+        }
+
+        std::uint64_t next() {
+            const std::uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+            const std::uint64_t t = s[1] << 17;
+
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+
+            return result;
+        }
+
+        // uniform real in [0,1), built from the top 53 (or 24) bits of the output.
+        double next_double() { return double(next() >> 11) * 0x1.0p-53; }
+        float next_float() { return float(next() >> 40) * 0x1.0p-24f; }
+
+        // bulk generation for consumers that want a whole buffer of numbers at once.
+        void fill(double* out, std::size_t n) {
+            for (std::size_t i = 0; i < n; i++) out[i] = next_double();
+        }
+
+        void fill(float* out, std::size_t n) {
+            // every 64 bit output holds two 24 bit floats.
+            std::size_t i = 0;
+            for (; i + 1 < n; i += 2) {
+                auto x = next();
+                out[i] = float(x >> 40) * 0x1.0p-24f;
+                out[i+1] = float((x >> 8) & 0xffffff) * 0x1.0p-24f;
+            }
+            if (i < n) out[i] = next_float();
+        }
+};
+
+inline std::atomic<std::uint64_t>& random_seed() {
+    // base seed shared by all threads. change it before any thread draws a number.
+    static std::atomic<std::uint64_t> seed{0x853c49e6748fea9bull};
+    return seed;
+}
+
+inline std::uint64_t next_thread_stream() {
+    static std::atomic<std::uint64_t> streams{0};
+    return streams++;
+}
+
+inline xoshiro256pp& thread_rng() {
+    // each thread lazily creates its generator on its first draw.
+    thread_local xoshiro256pp rng(random_seed().load() ^ (next_thread_stream() * 0xd1b54a32d192ed03ull));
+    return rng;
+}
+
+inline void seed_thread_rng(std::uint64_t seed) {
+    // restart the calling thread's generator from a given seed.
+    thread_rng().reseed(seed);
+}
+
+#endif
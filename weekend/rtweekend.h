@@ -8,6 +8,8 @@
 #include <limits>
 #include <memory>
 
+#include "random.h"
+
 
 using std::make_shared;
 using std::shared_ptr;
@@ -22,14 +24,23 @@ inline double degrees_to_radians(double degrees) {
 }
 
 inline double random_double() {
-    // returns a random real number in [0,1)
-    return std::rand()/(RAND_MAX+1.0);
+    // returns a random real number in [0,1), drawn from the calling thread's generator.
+    return thread_rng().next_double();
 }
 
 inline double random_double(double min, double max) {
     return min+(max-min)*random_double();
 }
 
+inline void random_doubles(double* out, size_t n) {
+    // fills out[0..n) with random reals in [0,1).
+    thread_rng().fill(out, n);
+}
+
+inline void random_floats(float* out, size_t n) {
+    thread_rng().fill(out, n);
+}
+
 // common headers.
 #include "color.h"
 #include "ray.h"